@@ -0,0 +1,225 @@
+/*
+ * The runtime's integer input (src/rtio.h) against scanf("%d").
+ *
+ *   bench_input [count]   reads `count` integers (default 10M) of mixed width and
+ *                         as many of ten digits with both, prints M values/s
+ *   bench_input --check   400 random inputs with whitespace variants, signs,
+ *                         garbage, leading zeros, long digit runs and overflow;
+ *                         both readers have to return the same results
+ *
+ * CMake builds it twice: bench_input uses SSE2 where the target has it,
+ * bench_input_scalar is compiled with MILA_IN_SCALAR.
+ */
+
+#include "rtio.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#ifdef MILA_IN_SSE2
+#define VARIANT "SSE2"
+#else
+#define VARIANT "scalar"
+#endif
+
+static unsigned long long state = 0x2545F4914F6CDD1Dull;
+
+// xorshift64*, the same sequence on every run
+static unsigned random32(void)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (unsigned)((state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static unsigned random_below(unsigned bound)
+{
+    return random32() % bound;
+}
+
+static void random_digits(FILE *file, unsigned count)
+{
+    while (count-- > 0)
+        fputc('0' + (int)random_below(10), file);
+}
+
+// one input for --check, up to 3000 tokens
+static void random_input(FILE *file)
+{
+    static const char *const spaces[] = {" ", "\n", "\t", "\r", "\v", "\f", "  ", "\n\n"};
+    static const char *const odd[] = {"-", "+", "x", "--5", "+-3", "1a", "9223372036854775807", "9223372036854775808",
+                                      "-9223372036854775808", "-9223372036854775809", "18446744073709551616",
+                                      "4294967296", "-2147483649"};
+    static const char *const tails[] = {"-", "+", "12"};
+
+    for (unsigned tokens = 1 + random_below(3000); tokens > 0; --tokens)
+    {
+        unsigned kind = random_below(100);
+        if (kind < 50)
+            fprintf(file, "%d", (int)random32());
+        else if (kind < 60)
+        {
+            // beyond long
+            if (random_below(2))
+                fputc('-', file);
+            random_digits(file, 1 + random_below(26));
+        }
+        else if (kind < 65)
+        {
+            fputc(random_below(2) ? '-' : '+', file);
+            for (unsigned zeros = random_below(41); zeros > 0; --zeros)
+                fputc('0', file);
+            fprintf(file, "%u", random_below(100000));
+        }
+        else if (kind < 70)
+            fputs(odd[random_below(sizeof odd / sizeof *odd)], file);
+        else if (kind < 72)
+            for (unsigned sevens = 10 + random_below(191); sevens > 0; --sevens)
+                fputc('7', file);
+        else
+            fprintf(file, "%u", random_below(1001));
+        if (random_below(100) < 95)
+            fputs(spaces[random_below(sizeof spaces / sizeof *spaces)], file);
+    }
+    if (random_below(10) < 3)
+        fputs(tails[random_below(3)], file);
+}
+
+// makes `file` the standard input of both readers, from its start
+static void use_input(FILE *file)
+{
+    fflush(file);
+    if (dup2(fileno(file), 0) < 0)
+    {
+        perror("dup2");
+        exit(1);
+    }
+    lseek(0, 0, SEEK_SET);
+    fseek(stdin, 0, SEEK_SET);
+    clearerr(stdin);
+    mila_in_pos = mila_in_end = 0;
+    mila_in_eof = 0;
+}
+
+/*
+ * Reads the whole input with scanf or mila_in_int, storing status and value
+ * of every call in `results`. A character no number starts with is skipped,
+ * as a program reading on would. Returns the number of calls.
+ */
+static size_t read_all(int useScanf, int **results, size_t *capacity)
+{
+    size_t calls = 0;
+    int status;
+    do
+    {
+        int x = 7;
+        status = useScanf ? scanf("%d", &x) : mila_in_int(&x);
+        if (status == 0)
+        {
+            if (useScanf)
+                getchar();
+            else if (mila_in_pos < mila_in_end || mila_in_fill())
+                ++mila_in_pos;
+        }
+        if (2 * calls + 2 > *capacity)
+        {
+            *capacity = *capacity ? 2 * *capacity : 1024;
+            *results = realloc(*results, *capacity * sizeof **results);
+        }
+        (*results)[2 * calls] = status;
+        (*results)[2 * calls + 1] = x;
+        ++calls;
+    } while (status != EOF);
+    return calls;
+}
+
+static int check(void)
+{
+    int *expected = NULL, *actual = NULL;
+    size_t expectedCapacity = 0, actualCapacity = 0;
+    for (int input = 0; input < 400; ++input)
+    {
+        FILE *file = tmpfile();
+        random_input(file);
+        use_input(file);
+        size_t expectedCalls = read_all(1, &expected, &expectedCapacity);
+        use_input(file);
+        size_t actualCalls = read_all(0, &actual, &actualCapacity);
+        fclose(file);
+
+        for (size_t call = 0; call < expectedCalls; ++call)
+        {
+            if (call == actualCalls || expected[2 * call] != actual[2 * call] ||
+                expected[2 * call + 1] != actual[2 * call + 1])
+            {
+                fprintf(stderr, VARIANT ": input %d differs from scanf at call %zu\n", input, call);
+                return 1;
+            }
+        }
+    }
+    free(expected);
+    free(actual);
+    printf(VARIANT ": 400 inputs read like scanf\n");
+    return 0;
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// `count` numbers of 1 to 10 digits with random signs, or positive ten-digit ones
+static void benchmark(const char *name, long count, int tenDigits)
+{
+    FILE *file = tmpfile();
+    for (long i = 0; i < count; ++i)
+    {
+        if (tenDigits)
+            fprintf(file, "%u\n", 1000000000u + random_below(1000000000u));
+        else
+        {
+            if (random_below(2))
+                fputc('-', file);
+            fputc('1' + (int)random_below(9), file);
+            random_digits(file, (unsigned)(i % 10));
+            fputc('\n', file);
+        }
+    }
+
+    long long sums[2] = {0, 0};
+    double rates[2];
+    for (int useScanf = 1; useScanf >= 0; --useScanf)
+    {
+        use_input(file);
+        long values = 0;
+        int x;
+        double start = seconds();
+        if (useScanf)
+            while (scanf("%d", &x) == 1)
+                sums[1] += x, ++values;
+        else
+            while (mila_in_int(&x) == 1)
+                sums[0] += x, ++values;
+        rates[useScanf] = (double)values / (seconds() - start) / 1e6;
+    }
+    fclose(file);
+
+    if (sums[0] != sums[1])
+        fprintf(stderr, "%s: the sums differ\n", name);
+    printf("%-20s %10.1f %10.1f\n", name, rates[1], rates[0]);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return check();
+
+    long count = argc > 1 ? atol(argv[1]) : 10000000;
+    printf("M values/s           %10s %10s\n", "scanf", VARIANT);
+    benchmark("mixed 1-10 digits", count, 0);
+    benchmark("10-digit numbers", count, 1);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * The runtime's integer output (src/rtio.h) against printf("%d\n").
+ *
+ *   bench_output [count]   writes `count` integers (default 20M) of mixed width
+ *                          and sign to /dev/null with both, prints M ints/s
+ *   bench_output --check   1M such integers and the int edge cases, as writeln
+ *                          and write; both have to produce the same bytes
+ */
+
+#include "rtio.h"
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+static const int edges[] = {0, 1, -1, 9, 10, -10, 99, 100, -100, 999999999, 1000000000, -1000000000, INT_MAX, INT_MIN};
+#define EDGES (long)(sizeof edges / sizeof *edges)
+
+// the edge cases first, then a linear congruential sequence shifted to 1 to 32 bit wide values
+static int value(long i, unsigned *v)
+{
+    if (i < EDGES)
+        return edges[i];
+    *v = *v * 1103515245u + 12345u;
+    return (int)*v >> (i & 15);
+}
+
+// every eighth number without a newline, like write
+static int newline(long i)
+{
+    return i % 8 != 0;
+}
+
+/*
+ * Writes `count` numbers to descriptor `fd` through printf or mila_out_int
+ * and returns the time it took, flushing included.
+ */
+static double write_all(int usePrintf, long count, int fd)
+{
+    fflush(stdout);
+    int console = dup(1);
+    dup2(fd, 1);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    unsigned v = 12345;
+    for (long i = 0; i < count; ++i)
+    {
+        int x = value(i, &v);
+        if (usePrintf)
+            printf(newline(i) ? "%d\n" : "%d", x);
+        else
+            mila_out_int(x, newline(i));
+    }
+    mila_out_flush();
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    dup2(console, 1);
+    close(console);
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static int check(void)
+{
+    const long count = 1000000;
+    FILE *files[2] = {tmpfile(), tmpfile()};
+    for (int usePrintf = 0; usePrintf < 2; ++usePrintf)
+        write_all(usePrintf, count, fileno(files[usePrintf]));
+
+    char blocks[2][1 << 16];
+    size_t offset = 0, sizes[2];
+    rewind(files[0]);
+    rewind(files[1]);
+    do
+    {
+        sizes[0] = fread(blocks[0], 1, sizeof blocks[0], files[0]);
+        sizes[1] = fread(blocks[1], 1, sizeof blocks[1], files[1]);
+        if (sizes[0] != sizes[1] || memcmp(blocks[0], blocks[1], sizes[0]) != 0)
+        {
+            fprintf(stderr, "the output differs from printf after byte %zu\n", offset);
+            return 1;
+        }
+        offset += sizes[0];
+    } while (sizes[0] > 0);
+    printf("%ld integers written like printf, %zu bytes\n", count, offset);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+        return check();
+
+    long count = argc > 1 ? atol(argv[1]) : 20000000;
+    int null = open("/dev/null", O_WRONLY);
+    if (null < 0)
+    {
+        perror("/dev/null");
+        return 1;
+    }
+    double printfSeconds = write_all(1, count, null);
+    double bufferedSeconds = write_all(0, count, null);
+    close(null);
+    printf("M ints/s    printf %.1f    buffered %.1f\n", (double)count / printfSeconds / 1e6,
+           (double)count / bufferedSeconds / 1e6);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef PJPPROJECT_ARENA_HPP
+#define PJPPROJECT_ARENA_HPP
+
+#include <memory>
+#include <utility>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/Allocator.h>
+
+/*
+ * Bump allocator for the AST of one compilation.
+ *
+ * Nodes are never freed one by one: destructors are not run and the whole
+ * tree goes away with the arena, so anything allocated here must not own
+ * heap memory. Child lists are copied into the arena and handed out as
+ * ArrayRef spans.
+ */
+class Arena
+{
+public:
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        ++m_Nodes;
+        return new (m_Allocator.Allocate(sizeof(T), llvm::Align(alignof(T)))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    llvm::ArrayRef<T> copy(llvm::ArrayRef<T> items)
+    {
+        if (items.empty())
+            return {};
+        T *storage = m_Allocator.Allocate<T>(items.size());
+        std::uninitialized_copy(items.begin(), items.end(), storage);
+        return llvm::ArrayRef<T>(storage, items.size());
+    }
+
+    size_t nodeCount() const { return m_Nodes; }
+    size_t bytesAllocated() const { return m_Allocator.getBytesAllocated(); }
+    size_t slabCount() const { return m_Allocator.GetNumSlabs(); }
+
+private:
+    llvm::BumpPtrAllocator m_Allocator;
+    size_t m_Nodes = 0;
+};
+
+#endif // PJPPROJECT_ARENA_HPP
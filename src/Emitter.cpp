@@ -0,0 +1,203 @@
+#include "Emitter.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#if LLVM_VERSION_MAJOR >= 14
+#include <llvm/MC/TargetRegistry.h>
+#else
+#include <llvm/Support/TargetRegistry.h>
+#endif
+
+// both come from CMake: the C compiler used as linker driver and the runtime library built from fce.c
+#ifndef MILA_LINKER
+#define MILA_LINKER "cc"
+#endif
+#ifndef MILA_RUNTIME
+#error "MILA_RUNTIME must name the runtime library built from src/fce.c"
+#endif
+
+llvm::CodeGenOpt::Level codeGenLevel(unsigned optLevel)
+{
+    switch (optLevel)
+    {
+    case 0:
+        return llvm::CodeGenOpt::None;
+    case 1:
+        return llvm::CodeGenOpt::Less;
+    case 2:
+        return llvm::CodeGenOpt::Default;
+    default:
+        return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(unsigned optLevel)
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target)
+        throw std::runtime_error("No target for " + triple + ": " + error);
+
+    // generic CPU, same as llc without -mcpu, so binaries run on any machine of the architecture;
+    // fastcc tail calls always reuse the frame (internalizeFunctions)
+    llvm::TargetOptions options;
+    options.GuaranteedTailCallOpt = true;
+    std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+        triple, "generic", "", options, llvm::Reloc::PIC_, llvm::None, codeGenLevel(optLevel)));
+    if (!machine)
+        throw std::runtime_error("Cannot create a target machine for " + triple);
+    return machine;
+}
+
+void emitModule(llvm::Module &module, llvm::TargetMachine &target, EmitKind kind, const std::string &fileName)
+{
+    if (kind == EmitKind::Executable)
+        return emitExecutable(module, target, fileName);
+
+    bool text = kind == EmitKind::LLVM || kind == EmitKind::Assembly;
+    std::error_code errorCode;
+    llvm::ToolOutputFile output(fileName, errorCode, text ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+    if (errorCode)
+        throw std::runtime_error("Cannot open " + fileName + ": " + errorCode.message());
+
+    switch (kind)
+    {
+    case EmitKind::LLVM:
+        module.print(output.os(), nullptr);
+        break;
+    case EmitKind::Bitcode:
+        llvm::WriteBitcodeToFile(module, output.os());
+        break;
+    case EmitKind::Assembly:
+    case EmitKind::Object:
+    case EmitKind::Executable:
+    {
+        llvm::legacy::PassManager codeGen;
+        llvm::CodeGenFileType fileType = kind == EmitKind::Object ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
+        if (target.addPassesToEmitFile(codeGen, output.os(), nullptr, fileType))
+            throw std::runtime_error("The target cannot emit this file type");
+        codeGen.run(module);
+        break;
+    }
+    }
+    output.keep();
+}
+
+// below this many function definitions per thread the partitioning costs more than the threads save
+static constexpr size_t parallelBackendMinFunctions = 256;
+
+// number of object files to compile `module` into, one per backend thread
+static unsigned backendPartitions(const llvm::Module &module, unsigned jobs)
+{
+    size_t definitions = 0;
+    for (const llvm::Function &function : module)
+        definitions += !function.isDeclaration();
+    size_t threads = llvm::hardware_concurrency(jobs).compute_thread_count();
+    return static_cast<unsigned>(std::max<size_t>(1, std::min(threads, definitions / parallelBackendMinFunctions)));
+}
+
+/*
+ * Object code of `module` in one file per partition, each compiled on its own
+ * thread. llvm::splitCodeGen cuts the module like llvm::SplitModule, moves every
+ * part into a context of its own and runs instruction selection, register
+ * allocation and object emission there with a copy of `target`.
+ */
+static void emitObjectsParallel(llvm::Module &module, llvm::TargetMachine &target, llvm::ArrayRef<std::string> objectFiles)
+{
+    std::vector<std::unique_ptr<llvm::raw_fd_ostream>> outputs;
+    llvm::SmallVector<llvm::raw_pwrite_stream *, 8> streams;
+    for (const std::string &objectFile : objectFiles)
+    {
+        std::error_code errorCode;
+        outputs.push_back(std::make_unique<llvm::raw_fd_ostream>(objectFile, errorCode, llvm::sys::fs::OF_None));
+        if (errorCode)
+            throw std::runtime_error("Cannot open " + objectFile + ": " + errorCode.message());
+        streams.push_back(outputs.back().get());
+    }
+
+    // called on the backend threads, a target machine must not be shared between them
+    auto createTarget = [&target]() {
+        return std::unique_ptr<llvm::TargetMachine>(target.getTarget().createTargetMachine(
+            target.getTargetTriple().str(), target.getTargetCPU(), target.getTargetFeatureString(), target.Options,
+            target.getRelocationModel(), target.getCodeModel(), target.getOptLevel()));
+    };
+#if LLVM_VERSION_MAJOR >= 13
+    llvm::splitCodeGen(module, streams, {}, createTarget);
+#else
+    // this version takes over the module it splits
+    llvm::splitCodeGen(llvm::CloneModule(module), streams, {}, createTarget);
+#endif
+
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        outputs[i]->close();
+        if (outputs[i]->has_error())
+            throw std::runtime_error("Cannot write " + objectFiles[i] + ": " + outputs[i]->error().message());
+    }
+}
+
+void emitExecutable(llvm::Module &module, llvm::TargetMachine &target, const std::string &fileName, bool keepObject, bool verbose,
+                    unsigned jobs)
+{
+    // a kept object is the whole program, otherwise every backend thread writes one
+    std::vector<std::string> objectFiles;
+    std::vector<std::unique_ptr<llvm::FileRemover>> objectRemovers;
+    if (keepObject)
+    {
+        llvm::SmallString<128> objectFile(fileName);
+        llvm::sys::path::replace_extension(objectFile, "o");
+        objectFiles.push_back(std::string(objectFile));
+    }
+    else
+    {
+        for (unsigned partition = backendPartitions(module, jobs); partition > 0; --partition)
+        {
+            llvm::SmallString<128> objectFile;
+            if (std::error_code errorCode = llvm::sys::fs::createTemporaryFile("mila", "o", objectFile))
+                throw std::runtime_error("Cannot create a temporary object file: " + errorCode.message());
+            objectFiles.push_back(std::string(objectFile));
+            objectRemovers.push_back(std::make_unique<llvm::FileRemover>(objectFile));
+        }
+    }
+
+    if (objectFiles.size() == 1)
+        emitModule(module, target, EmitKind::Object, objectFiles.front());
+    else
+        emitObjectsParallel(module, target, objectFiles);
+
+    llvm::ErrorOr<std::string> linker = llvm::sys::findProgramByName(MILA_LINKER);
+    if (!linker)
+        throw std::runtime_error(std::string("Cannot find the linker driver ") + MILA_LINKER);
+
+    llvm::SmallVector<llvm::StringRef, 8> args{*linker};
+    args.append(objectFiles.begin(), objectFiles.end());
+    args.append({MILA_RUNTIME, "-o", fileName});
+    if (verbose)
+        std::cerr << llvm::join(args, " ") << std::endl;
+
+    std::string error;
+    int status = llvm::sys::ExecuteAndWait(*linker, args, llvm::None, {}, 0, 0, &error);
+    if (status != 0)
+        throw std::runtime_error("Linking " + fileName + " failed" + (error.empty() ? "" : ": " + error));
+}
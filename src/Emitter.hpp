@@ -0,0 +1,50 @@
+#ifndef PJPPROJECT_EMITTER_HPP
+#define PJPPROJECT_EMITTER_HPP
+
+#include <memory>
+#include <string>
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+enum class EmitKind
+{
+    LLVM,      // textual IR
+    Bitcode,   // binary IR
+    Assembly,  // native assembly
+    Object,    // native object file
+    Executable // object file linked with the runtime
+};
+
+// backend optimization level matching -O<optLevel>
+llvm::CodeGenOpt::Level codeGenLevel(unsigned optLevel);
+
+/*
+ * Target machine for the host, position independent code, code generation
+ * tuned for -O<optLevel>. Throws std::runtime_error if LLVM was built
+ * without a backend for the host.
+ */
+std::unique_ptr<llvm::TargetMachine> createHostTargetMachine(unsigned optLevel);
+
+/*
+ * Writes `module` to `fileName` ("-" is standard output) in the given form.
+ * The module must already carry the target's triple and data layout.
+ */
+void emitModule(llvm::Module &module, llvm::TargetMachine &target, EmitKind kind, const std::string &fileName);
+
+/*
+ * Compiles `module` to an object file and links it with the runtime library
+ * (src/fce.c, built by CMake) into the executable `fileName` with a single
+ * C compiler invocation. The object goes to a temporary file unless
+ * `keepObject` is set, then it is kept as `fileName` with extension .o.
+ * With `verbose` the linker command line is printed to stderr.
+ *
+ * Large modules are split into one temporary object per backend thread, up
+ * to `jobs` (0 = all hardware threads); a kept object is always compiled on
+ * one thread. Which functions share an object, and so the layout of the
+ * executable, depends on the number of threads.
+ */
+void emitExecutable(llvm::Module &module, llvm::TargetMachine &target, const std::string &fileName, bool keepObject = false,
+                    bool verbose = false, unsigned jobs = 1);
+
+#endif // PJPPROJECT_EMITTER_HPP
@@ -0,0 +1,823 @@
+#include "Interpreter.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+// computed goto is a GCC/Clang extension, -DMILA_COMPUTED_GOTO=0 selects the portable switch
+#ifndef MILA_COMPUTED_GOTO
+#if defined(__GNUC__)
+#define MILA_COMPUTED_GOTO 1
+#else
+#define MILA_COMPUTED_GOTO 0
+#endif
+#endif
+
+// the runtime also used by --run (runtime_jit.c)
+extern "C" {
+int mila_rt_writeln(int x);
+long long mila_rt_readln(void);
+}
+
+using Opcode = Interpreter::Opcode;
+using Reg = std::int32_t;
+
+class Interpreter::Lowering
+{
+public:
+  explicit Lowering(Interpreter &interpreter) : m_Code(interpreter.m_Code), m_Functions(interpreter.m_Functions) {}
+
+  // returns the index of main
+  std::uint32_t program(const ProgramASTNode &program);
+
+private:
+  std::size_t emit(Opcode op, std::int32_t a = 0, std::int32_t b = 0, std::int32_t c = 0);
+  std::size_t here() const { return m_Code.size(); }
+  void patch(llvm::ArrayRef<std::size_t> jumps, std::size_t target);
+  Reg temporary();
+
+  void function(const FunctionASTNode &function);
+  void declareVariable(SymbolId name, const ExprASTNode *initial);
+  Reg variable(SymbolId name) const;
+
+  void statement(const ASTNode *node);
+  Reg expression(const ExprASTNode *node);
+  void expressionInto(const ExprASTNode *node, Reg target);
+  void call(const FunctionCallExprASTNode *node, Reg target);
+  // jumps appended to `jumps` are taken when condition is nonzero (`when` set) or 0 (`when` clear);
+  // and/or of comparisons short-circuit like in the code generator (GenContext::branchOn)
+  void branchIf(const ExprASTNode *condition, bool when, std::vector<std::size_t> &jumps);
+
+  std::vector<Instruction> &m_Code;
+  std::vector<Function> &m_Functions;
+  llvm::DenseMap<SymbolId, std::uint32_t> m_FunctionIndex;
+
+  // state of the function being lowered
+  llvm::DenseMap<SymbolId, Reg> m_Variables;
+  llvm::DenseMap<SymbolId, std::int32_t> m_Constants;
+  Reg m_Top = 0;       // first free register, temporaries are released after each statement
+  Reg m_FrameSize = 0; // highest m_Top so far
+  std::vector<std::vector<std::size_t>> m_Breaks; // per enclosing loop, jumps to its exit
+  std::vector<std::size_t> m_Exits;               // jumps to the epilogue
+  std::uint32_t m_Current = 0;                    // index of the function
+  std::uint32_t m_Entry = 0;                      // its first instruction
+  llvm::SmallPtrSet<const FunctionCallExprASTNode *, 4> m_TailCalls;
+};
+
+static Opcode arithmeticOpcode(int op)
+{
+  switch (op)
+  {
+  case '+':
+    return Opcode::Add;
+  case '-':
+    return Opcode::Sub;
+  case '*':
+    return Opcode::Mul;
+  case tok_div:
+    return Opcode::Div;
+  case tok_mod:
+    return Opcode::Mod;
+  case tok_and:
+    return Opcode::And;
+  case tok_or:
+    return Opcode::Or;
+  case '=':
+    return Opcode::Eq;
+  case tok_notequal:
+    return Opcode::Ne;
+  case '<':
+    return Opcode::Lt;
+  case '>':
+    return Opcode::Gt;
+  case tok_lessequal:
+    return Opcode::Le;
+  case tok_greaterequal:
+    return Opcode::Ge;
+  default:
+    throw std::logic_error("no operator");
+  }
+}
+
+// the conditional jump taken when comparison `op` is false, Halt when op is no comparison
+static Opcode inverseJump(int op)
+{
+  switch (op)
+  {
+  case '=':
+    return Opcode::JumpNe;
+  case tok_notequal:
+    return Opcode::JumpEq;
+  case '<':
+    return Opcode::JumpGe;
+  case '>':
+    return Opcode::JumpLe;
+  case tok_lessequal:
+    return Opcode::JumpGt;
+  case tok_greaterequal:
+    return Opcode::JumpLt;
+  default:
+    return Opcode::Halt;
+  }
+}
+
+// the conditional jump with the opposite condition
+static Opcode negatedJump(Opcode jump)
+{
+  switch (jump)
+  {
+  case Opcode::JumpEq:
+    return Opcode::JumpNe;
+  case Opcode::JumpNe:
+    return Opcode::JumpEq;
+  case Opcode::JumpLt:
+    return Opcode::JumpGe;
+  case Opcode::JumpGe:
+    return Opcode::JumpLt;
+  case Opcode::JumpGt:
+    return Opcode::JumpLe;
+  case Opcode::JumpLe:
+    return Opcode::JumpGt;
+  default:
+    throw std::logic_error("no conditional jump");
+  }
+}
+
+std::size_t Interpreter::Lowering::emit(Opcode op, std::int32_t a, std::int32_t b, std::int32_t c)
+{
+  m_Code.push_back({op, a, b, c});
+  return m_Code.size() - 1;
+}
+
+void Interpreter::Lowering::patch(llvm::ArrayRef<std::size_t> jumps, std::size_t target)
+{
+  for (std::size_t jump : jumps)
+    m_Code[jump].c = static_cast<std::int32_t>(target);
+}
+
+Reg Interpreter::Lowering::temporary()
+{
+  m_FrameSize = std::max(m_FrameSize, m_Top + 1);
+  return m_Top++;
+}
+
+std::uint32_t Interpreter::Lowering::program(const ProgramASTNode &program)
+{
+  for (const FunctionASTNode *function : program.getFunctions())
+    this->function(*function);
+
+  for (const auto &[name, index] : m_FunctionIndex)
+    if (!m_Functions[index].defined)
+      throw std::logic_error("Function " + SymbolPool::global().name(name).str() + " has no body");
+  auto main = m_FunctionIndex.find(SymbolPool::sym_main);
+  if (main == m_FunctionIndex.end())
+    throw std::logic_error("Program has no main block");
+  return main->second;
+}
+
+void Interpreter::Lowering::function(const FunctionASTNode &function)
+{
+  const PrototypeASTNode *prototype = function.getPrototype();
+  auto [it, inserted] = m_FunctionIndex.try_emplace(prototype->getName(), m_Functions.size());
+  if (inserted)
+  {
+    m_Functions.emplace_back();
+    m_Functions.back().params = prototype->getArgs().size();
+    m_Functions.back().returnsValue = prototype->m_type == PrototypeASTNode::FUNCTION;
+    m_Functions.back().name = prototype->getName();
+  }
+  if (!function.getBody())
+    return;
+  if (m_Functions[it->second].defined)
+    throw std::logic_error("Function already defined");
+
+  std::uint32_t entry = here();
+  m_Current = it->second;
+  m_Entry = entry;
+  m_TailCalls.clear();
+  function.collectTailCalls(m_TailCalls);
+  m_Variables.clear();
+  m_Constants.clear();
+  m_Exits.clear();
+  m_Top = 0;
+  m_FrameSize = 1;
+
+  bool isMain = prototype->getName() == SymbolPool::sym_main;
+  // arguments arrive in the first registers
+  for (SymbolId arg : prototype->getArgs())
+  {
+    if (!m_Variables.try_emplace(arg, temporary()).second)
+      throw std::logic_error("Variable already declared");
+  }
+  if (!isMain && prototype->getReturnValue())
+    declareVariable(prototype->getReturnValue()->getName(), prototype->getReturnValue()->getValue());
+  for (const VariableDeclarationASTNode *variable : function.getVariables())
+    declareVariable(variable->getName(), variable->getValue());
+  for (const ConstantDeclarationASTNode *constant : function.getConstants())
+  {
+    if (m_Variables.count(constant->getName()) > 0)
+      throw std::logic_error("Variable already declared");
+    m_Constants[constant->getName()] = constant->getValue();
+  }
+
+  statement(function.getBody());
+
+  patch(m_Exits, here());
+  if (isMain)
+  {
+    Reg zero = temporary();
+    emit(Opcode::Const, zero, 0);
+    emit(Opcode::Ret, zero);
+  }
+  else if (prototype->m_type == PrototypeASTNode::PROCEDURE)
+    emit(Opcode::RetVoid);
+  else
+    emit(Opcode::Ret, variable(prototype->getName()));
+
+  // looked up again: lowering calls may have declared further functions
+  Function &lowered = m_Functions[it->second];
+  lowered.entry = entry;
+  lowered.frameSize = m_FrameSize;
+  lowered.defined = true;
+}
+
+void Interpreter::Lowering::declareVariable(SymbolId name, const ExprASTNode *initial)
+{
+  if (m_Variables.count(name) > 0)
+    throw std::logic_error("Variable already declared");
+  // the initializer cannot see the variable yet, so it is evaluated before the register is taken
+  Reg slot = m_Top;
+  if (initial)
+    expressionInto(initial, slot);
+  else // code generation leaves these undefined, zero is one of the possible values
+    emit(Opcode::Const, slot, 0);
+  m_Variables[name] = slot;
+  m_Top = slot;
+  temporary();
+}
+
+Reg Interpreter::Lowering::variable(SymbolId name) const
+{
+  auto it = m_Variables.find(name);
+  if (it == m_Variables.end())
+    throw std::logic_error("variable not defined");
+  return it->second;
+}
+
+void Interpreter::Lowering::statement(const ASTNode *node)
+{
+  if (!node)
+    return;
+  Reg top = m_Top;
+  switch (node->getKind())
+  {
+  case ASTNode::Kind::BlockStatement:
+    for (const ExprASTNode *expression : llvm::cast<BlockStatmentASTNode>(node)->getExpressions())
+      statement(expression);
+    break;
+  case ASTNode::Kind::MainFunctionBlockStatement:
+    for (const ExprASTNode *expression : llvm::cast<MainFunctionBlockStatementASTNode>(node)->getExpressions())
+      statement(expression);
+    break;
+  case ASTNode::Kind::Assignment:
+  {
+    const auto *assignment = llvm::cast<AssignmentASTNode>(node);
+    if (m_Variables.count(assignment->getVariable()->getName()) == 0)
+      throw std::logic_error("var not declared");
+    expressionInto(assignment->getExpr(), variable(assignment->getVariable()->getName()));
+    break;
+  }
+  case ASTNode::Kind::FunctionCall:
+    call(llvm::cast<FunctionCallExprASTNode>(node), temporary());
+    break;
+  case ASTNode::Kind::Readln:
+    emit(Opcode::ReadLn, variable(llvm::cast<ReadlnExprASTNode>(node)->getVariable()->getName()));
+    break;
+  case ASTNode::Kind::For:
+  {
+    const auto *loop = llvm::cast<ForASTNode>(node);
+    bool up = loop->getType() == ForASTNode::TO;
+    statement(loop->getAssign());
+    Reg counter = variable(loop->getVariable());
+    // the bound is evaluated once, into a register of its own: the body may assign what it reads
+    Reg bound = temporary();
+    expressionInto(loop->getBound(), bound);
+    m_Breaks.emplace_back(1, emit(up ? Opcode::JumpGt : Opcode::JumpLt, counter, bound));
+    // the increment starts from the value the iteration began with, whatever the body assigned;
+    // the iteration for the bound is the last one, like in ForASTNode::codegen
+    std::size_t body = here();
+    Reg seen = temporary();
+    emit(Opcode::Move, seen, counter);
+    statement(loop->getBody());
+    emit(Opcode::AddImm, counter, seen, up ? 1 : -1);
+    m_Breaks.back().push_back(emit(Opcode::JumpEq, seen, bound));
+    emit(Opcode::Loop, m_Current, 0, body);
+    patch(m_Breaks.back(), here());
+    m_Breaks.pop_back();
+    break;
+  }
+  case ASTNode::Kind::While:
+  {
+    const auto *loop = llvm::cast<WhileASTNode>(node);
+    std::size_t condition = here();
+    m_Breaks.emplace_back();
+    branchIf(loop->getCondition(), false, m_Breaks.back());
+    statement(loop->getBody());
+    emit(Opcode::Loop, m_Current, 0, condition);
+    patch(m_Breaks.back(), here());
+    m_Breaks.pop_back();
+    break;
+  }
+  case ASTNode::Kind::IfElse:
+  {
+    const auto *ifElse = llvm::cast<IfElseASTNode>(node);
+    std::vector<std::size_t> toElse;
+    branchIf(ifElse->getCondition(), false, toElse);
+    m_Top = top;
+    statement(ifElse->getThen());
+    if (ifElse->getElse())
+    {
+      std::size_t toEnd = emit(Opcode::Jump);
+      patch(toElse, here());
+      statement(ifElse->getElse());
+      patch(toEnd, here());
+    }
+    else
+      patch(toElse, here());
+    break;
+  }
+  case ASTNode::Kind::Break:
+    if (m_Breaks.empty())
+      throw std::logic_error("break outside of a loop");
+    m_Breaks.back().push_back(emit(Opcode::Jump));
+    break;
+  case ASTNode::Kind::FunctionExit:
+    m_Exits.push_back(emit(Opcode::Jump));
+    break;
+  default:
+    if (const auto *expression = llvm::dyn_cast<ExprASTNode>(node))
+      this->expression(expression);
+    else
+      throw std::logic_error("Unexpected statement");
+  }
+  m_Top = top;
+}
+
+Reg Interpreter::Lowering::expression(const ExprASTNode *node)
+{
+  switch (node->getKind())
+  {
+  case ASTNode::Kind::Variable:
+  {
+    SymbolId name = llvm::cast<VariableASTNode>(node)->getName();
+    if (auto it = m_Constants.find(name); it != m_Constants.end())
+    {
+      Reg target = temporary();
+      emit(Opcode::Const, target, it->second);
+      return target;
+    }
+    return variable(name);
+  }
+  case ASTNode::Kind::Assignment:
+    statement(node);
+    return variable(llvm::cast<AssignmentASTNode>(node)->getVariable()->getName());
+  case ASTNode::Kind::Increment:
+  case ASTNode::Kind::Decrement:
+  {
+    bool increment = node->getKind() == ASTNode::Kind::Increment;
+    const VariableASTNode *operand = increment ? llvm::cast<IncrementExprASTNode>(node)->getVariable()
+                                               : llvm::cast<DecrementExprASTNode>(node)->getVariable();
+    Reg target = variable(operand->getName());
+    emit(Opcode::AddImm, target, expression(operand), increment ? 1 : -1);
+    return target;
+  }
+  case ASTNode::Kind::Readln:
+    statement(node);
+    return variable(llvm::cast<ReadlnExprASTNode>(node)->getVariable()->getName());
+  case ASTNode::Kind::Number:
+  case ASTNode::Kind::UnaryOperation:
+  case ASTNode::Kind::BinaryOperation:
+  case ASTNode::Kind::FunctionCall:
+  {
+    Reg target = temporary();
+    expressionInto(node, target);
+    return target;
+  }
+  default:
+    throw std::logic_error("Statement used as a value");
+  }
+}
+
+void Interpreter::Lowering::expressionInto(const ExprASTNode *node, Reg target)
+{
+  switch (node->getKind())
+  {
+  case ASTNode::Kind::Number:
+    emit(Opcode::Const, target, llvm::cast<NumberASTNode>(node)->getValue());
+    return;
+  case ASTNode::Kind::UnaryOperation:
+  {
+    const auto *unary = llvm::cast<UnaryOperationASTNode>(node);
+    if (unary->getOperator() == '+')
+      expressionInto(unary->getExpr(), target);
+    else
+      emit(Opcode::Neg, target, expression(unary->getExpr()));
+    return;
+  }
+  case ASTNode::Kind::BinaryOperation:
+  {
+    // operands first: target may be one of the variables they read
+    const auto *binary = llvm::cast<BinaryOperationASTNode>(node);
+    Reg lhs = expression(binary->getLHS());
+    Reg rhs = expression(binary->getRHS());
+    emit(arithmeticOpcode(binary->getOperator()), target, lhs, rhs);
+    return;
+  }
+  case ASTNode::Kind::FunctionCall:
+    call(llvm::cast<FunctionCallExprASTNode>(node), target);
+    return;
+  default:
+  {
+    Reg value = expression(node);
+    if (value != target)
+      emit(Opcode::Move, target, value);
+  }
+  }
+}
+
+void Interpreter::Lowering::call(const FunctionCallExprASTNode *node, Reg target)
+{
+  llvm::ArrayRef<ExprASTNode *> args = node->getArgs();
+  if (node->getCallee() == SymbolPool::sym_writeln)
+  {
+    if (args.size() != 1)
+      throw std::logic_error("Arguments Missmatch");
+    emit(Opcode::WriteLn, expression(args[0]));
+    emit(Opcode::Const, target, 0);
+    return;
+  }
+
+  auto callee = m_FunctionIndex.find(node->getCallee());
+  if (callee == m_FunctionIndex.end())
+    throw std::logic_error("Function not defined");
+  if (m_Functions[callee->second].params != args.size())
+    throw std::logic_error("Arguments Missmatch");
+
+  // arguments go to consecutive registers at the top, they become the callee's first registers
+  Reg base = m_Top;
+  for (std::size_t i = 0; i < args.size(); ++i)
+  {
+    m_Top = base + i;
+    expressionInto(args[i], temporary());
+  }
+  m_Top = base;
+  if (callee->second == m_Current && m_TailCalls.count(node))
+  {
+    // self-recursion in tail position reuses the frame, like the musttail call of the code generator:
+    // the arguments become the parameters and the function starts over
+    for (std::size_t i = 0; i < args.size(); ++i)
+      emit(Opcode::Move, i, base + i);
+    emit(Opcode::Loop, m_Current, 0, m_Entry);
+    return;
+  }
+  if (m_TailCalls.count(node) && m_Functions[callee->second].returnsValue == m_Functions[m_Current].returnsValue)
+  {
+    // like the fastcc tail calls of the code generator, also between different prototypes
+    emit(Opcode::TailCall, base, callee->second);
+    return;
+  }
+  emit(Opcode::Call, base, callee->second, target);
+}
+
+void Interpreter::Lowering::branchIf(const ExprASTNode *condition, bool when, std::vector<std::size_t> &jumps)
+{
+  if (const auto *binary = llvm::dyn_cast<BinaryOperationASTNode>(condition))
+  {
+    int op = binary->getOperator();
+    if ((op == tok_and || op == tok_or) && binary->isCondition())
+    {
+      if ((op == tok_and) != when)
+      {
+        // `and` jumping when false, `or` jumping when true: either operand decides alone
+        branchIf(binary->getLHS(), when, jumps);
+        branchIf(binary->getRHS(), when, jumps);
+        return;
+      }
+      // the left operand decides only the other way, then the right one is skipped
+      std::vector<std::size_t> decided;
+      branchIf(binary->getLHS(), !when, decided);
+      branchIf(binary->getRHS(), when, jumps);
+      patch(decided, here());
+      return;
+    }
+    Opcode jump = inverseJump(op);
+    if (jump != Opcode::Halt)
+    {
+      Reg lhs = expression(binary->getLHS());
+      Reg rhs = expression(binary->getRHS());
+      jumps.push_back(emit(when ? negatedJump(jump) : jump, lhs, rhs));
+      return;
+    }
+  }
+  Reg value = expression(condition);
+  if (when)
+  {
+    Reg zero = temporary();
+    emit(Opcode::Const, zero, 0);
+    jumps.push_back(emit(Opcode::JumpNe, value, zero));
+  }
+  else
+    jumps.push_back(emit(Opcode::JumpZero, value));
+}
+
+Interpreter::Interpreter(const ProgramASTNode &program)
+{
+  m_Main = Lowering(*this).program(program);
+  m_Counters.assign(m_Functions.size(), 0);
+  m_Native.reset(new std::atomic<void *>[m_Functions.size()]());
+}
+
+void Interpreter::enableTiering(std::uint32_t threshold, std::function<void(std::uint32_t)> onHot)
+{
+  m_Threshold = threshold;
+  m_OnHot = std::move(onHot);
+}
+
+void Interpreter::setNative(std::uint32_t function, void *entry)
+{
+  if (m_Functions[function].params <= maxNativeArity)
+    m_Native[function].store(entry, std::memory_order_release);
+}
+
+void Interpreter::reportHot(std::uint32_t function)
+{
+  // counters wrap around, with tiering off they end up here every 2^32 events
+  if (m_Threshold && function != m_Main)
+    m_OnHot(function);
+}
+
+template <typename Result>
+static Result callNative(void *entry, unsigned arity, const std::int32_t *a)
+{
+  using I = std::int32_t;
+  switch (arity)
+  {
+  case 0:
+    return reinterpret_cast<Result (*)()>(entry)();
+  case 1:
+    return reinterpret_cast<Result (*)(I)>(entry)(a[0]);
+  case 2:
+    return reinterpret_cast<Result (*)(I, I)>(entry)(a[0], a[1]);
+  case 3:
+    return reinterpret_cast<Result (*)(I, I, I)>(entry)(a[0], a[1], a[2]);
+  case 4:
+    return reinterpret_cast<Result (*)(I, I, I, I)>(entry)(a[0], a[1], a[2], a[3]);
+  case 5:
+    return reinterpret_cast<Result (*)(I, I, I, I, I)>(entry)(a[0], a[1], a[2], a[3], a[4]);
+  default:
+    static_assert(Interpreter::maxNativeArity == 6, "callNative covers arities up to maxNativeArity");
+    return reinterpret_cast<Result (*)(I, I, I, I, I, I)>(entry)(a[0], a[1], a[2], a[3], a[4], a[5]);
+  }
+}
+
+static std::int32_t wrapping(std::uint32_t value)
+{
+  return static_cast<std::int32_t>(value);
+}
+
+static std::int32_t divide(std::int32_t lhs, std::int32_t rhs, bool remainder)
+{
+  // native code traps on both
+  if (rhs == 0)
+    throw std::runtime_error("division by zero");
+  if (rhs == -1 && lhs == std::numeric_limits<std::int32_t>::min())
+    throw std::runtime_error("integer overflow in division");
+  return remainder ? lhs % rhs : lhs / rhs;
+}
+
+#if MILA_COMPUTED_GOTO && defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+int Interpreter::run()
+{
+  struct Frame
+  {
+    const Instruction *returnTo;
+    std::int32_t *registers;
+    Reg result;
+  };
+
+  std::unique_ptr<std::int32_t[]> stack(new std::int32_t[stackRegisters]);
+  const std::int32_t *stackEnd = stack.get() + stackRegisters;
+  std::vector<Frame> frames;
+  frames.reserve(64);
+
+  // returning from main lands on Halt with the exit code in `exitCode`
+  const Instruction halt{Opcode::Halt, 0, 0, 0};
+  std::int32_t exitCode = 0;
+  frames.push_back({&halt, &exitCode, 0});
+
+  const Instruction *code = m_Code.data();
+  const Function *functions = m_Functions.data();
+  std::uint32_t *counters = m_Counters.data();
+  const std::atomic<void *> *native = m_Native.get();
+  const std::uint32_t threshold = m_Threshold;
+  const Instruction *pc = code + functions[m_Main].entry;
+  std::int32_t *r = stack.get();
+
+#if MILA_COMPUTED_GOTO
+  static const void *const dispatch[] = {
+#define MILA_OPCODE_LABEL(name) &&op_##name,
+      MILA_OPCODES(MILA_OPCODE_LABEL)
+#undef MILA_OPCODE_LABEL
+  };
+#define OP(name) op_##name:
+#define NEXT() goto *dispatch[static_cast<std::uint8_t>(pc->op)]
+#else
+#define OP(name) case Opcode::name:
+#define NEXT() continue
+#endif
+
+#define BINARY(name, expr)                                                                                             \
+  OP(name)                                                                                                             \
+  {                                                                                                                    \
+    std::int32_t x = r[pc->b], y = r[pc->c];                                                                           \
+    r[pc->a] = (expr);                                                                                                 \
+    ++pc;                                                                                                              \
+    NEXT();                                                                                                            \
+  }
+#define JUMP_IF(name, cmp)                                                                                             \
+  OP(name)                                                                                                             \
+  {                                                                                                                    \
+    pc = r[pc->a] cmp r[pc->b] ? code + pc->c : pc + 1;                                                                \
+    NEXT();                                                                                                            \
+  }
+
+#if MILA_COMPUTED_GOTO
+  NEXT();
+  {
+#else
+  for (;;)
+    switch (pc->op)
+    {
+#endif
+      OP(Const)
+      {
+        r[pc->a] = pc->b;
+        ++pc;
+        NEXT();
+      }
+      OP(Move)
+      {
+        r[pc->a] = r[pc->b];
+        ++pc;
+        NEXT();
+      }
+      OP(Neg)
+      {
+        r[pc->a] = wrapping(0u - static_cast<std::uint32_t>(r[pc->b]));
+        ++pc;
+        NEXT();
+      }
+      OP(AddImm)
+      {
+        r[pc->a] = wrapping(static_cast<std::uint32_t>(r[pc->b]) + static_cast<std::uint32_t>(pc->c));
+        ++pc;
+        NEXT();
+      }
+      BINARY(Add, wrapping(static_cast<std::uint32_t>(x) + static_cast<std::uint32_t>(y)))
+      BINARY(Sub, wrapping(static_cast<std::uint32_t>(x) - static_cast<std::uint32_t>(y)))
+      BINARY(Mul, wrapping(static_cast<std::uint32_t>(x) * static_cast<std::uint32_t>(y)))
+      BINARY(Div, divide(x, y, false))
+      BINARY(Mod, divide(x, y, true))
+      BINARY(And, x & y)
+      BINARY(Or, x | y)
+      BINARY(Eq, x == y)
+      BINARY(Ne, x != y)
+      BINARY(Lt, x < y)
+      BINARY(Gt, x > y)
+      BINARY(Le, x <= y)
+      BINARY(Ge, x >= y)
+      OP(Jump)
+      {
+        pc = code + pc->c;
+        NEXT();
+      }
+      OP(Loop)
+      {
+        if (++counters[pc->a] == threshold)
+          reportHot(pc->a);
+        pc = code + pc->c;
+        NEXT();
+      }
+      OP(JumpZero)
+      {
+        pc = r[pc->a] == 0 ? code + pc->c : pc + 1;
+        NEXT();
+      }
+      JUMP_IF(JumpEq, ==)
+      JUMP_IF(JumpNe, !=)
+      JUMP_IF(JumpLt, <)
+      JUMP_IF(JumpGt, >)
+      JUMP_IF(JumpLe, <=)
+      JUMP_IF(JumpGe, >=)
+      OP(Call)
+      {
+        const Function &callee = functions[pc->b];
+        if (void *entry = native[pc->b].load(std::memory_order_acquire))
+        {
+          if (callee.returnsValue)
+            r[pc->c] = callNative<std::int32_t>(entry, callee.params, r + pc->a);
+          else
+            callNative<void>(entry, callee.params, r + pc->a);
+          ++pc;
+          NEXT();
+        }
+        if (++counters[pc->b] == threshold)
+          reportHot(pc->b);
+        std::int32_t *base = r + pc->a;
+        if (base + callee.frameSize > stackEnd)
+          throw std::runtime_error("stack overflow");
+        frames.push_back({pc + 1, r, pc->c});
+        r = base;
+        pc = code + callee.entry;
+        NEXT();
+      }
+      OP(TailCall)
+      {
+        const Function &callee = functions[pc->b];
+        if (void *entry = native[pc->b].load(std::memory_order_acquire))
+        {
+          std::int32_t value = 0;
+          if (callee.returnsValue)
+            value = callNative<std::int32_t>(entry, callee.params, r + pc->a);
+          else
+            callNative<void>(entry, callee.params, r + pc->a);
+          const Frame &caller = frames.back();
+          r = caller.registers;
+          if (callee.returnsValue)
+            r[caller.result] = value;
+          pc = caller.returnTo;
+          frames.pop_back();
+          NEXT();
+        }
+        if (++counters[pc->b] == threshold)
+          reportHot(pc->b);
+        if (r + callee.frameSize > stackEnd)
+          throw std::runtime_error("stack overflow");
+        // the arguments sit above every register of the current frame, copying upwards never overwrites one
+        for (std::uint32_t i = 0; i < callee.params; ++i)
+          r[i] = r[pc->a + i];
+        pc = code + callee.entry;
+        NEXT();
+      }
+      OP(Ret)
+      {
+        std::int32_t value = r[pc->a];
+        const Frame &caller = frames.back();
+        r = caller.registers;
+        r[caller.result] = value;
+        pc = caller.returnTo;
+        frames.pop_back();
+        NEXT();
+      }
+      OP(RetVoid)
+      {
+        const Frame &caller = frames.back();
+        r = caller.registers;
+        pc = caller.returnTo;
+        frames.pop_back();
+        NEXT();
+      }
+      OP(WriteLn)
+      {
+        mila_rt_writeln(r[pc->a]);
+        ++pc;
+        NEXT();
+      }
+      OP(ReadLn)
+      {
+        long long read = mila_rt_readln();
+        if (read >> 32 == 1)
+          r[pc->a] = static_cast<Reg>(read);
+        ++pc;
+        NEXT();
+      }
+      OP(Halt)
+      {
+        return exitCode;
+      }
+    }
+
+#undef JUMP_IF
+#undef BINARY
+#undef NEXT
+#undef OP
+}
+
+#if MILA_COMPUTED_GOTO && defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
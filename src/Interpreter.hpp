@@ -0,0 +1,114 @@
+#ifndef PJPPROJECT_INTERPRETER_HPP
+#define PJPPROJECT_INTERPRETER_HPP
+
+#include "ast.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+ * Every instruction has three 32-bit operands a, b, c. Registers are slots of
+ * the current call frame, jump targets are instruction indices and always go
+ * in c.
+ *
+ *   Const     r[a] = b
+ *   Move      r[a] = r[b]
+ *   Neg       r[a] = -r[b]
+ *   AddImm    r[a] = r[b] + c
+ *   Add..Or   r[a] = r[b] <op> r[c]             (Div, Mod check the divisor)
+ *   Eq..Ge    r[a] = r[b] <cmp> r[c] ? 1 : 0
+ *   Jump      goto c
+ *   Loop      goto c, a loop's back edge in function a (counted for tiering)
+ *   JumpZero  if r[a] == 0 goto c
+ *   JumpEq..  if r[a] <cmp> r[b] goto c
+ *   Call      frame of function b starts at r[a] (its arguments), result to r[c]
+ *   TailCall  function b replaces the current frame, its arguments at r[a]
+ *   Ret       return r[a];  RetVoid returns nothing
+ *   WriteLn   writeln(r[a]);  ReadLn  r[a] = readln() if a number was read
+ *   Halt      end of the program, only reached by returning from main
+ */
+#define MILA_OPCODES(X)                                                                                                \
+  X(Const) X(Move) X(Neg) X(AddImm)                                                                                    \
+  X(Add) X(Sub) X(Mul) X(Div) X(Mod) X(And) X(Or)                                                                      \
+  X(Eq) X(Ne) X(Lt) X(Gt) X(Le) X(Ge)                                                                                  \
+  X(Jump) X(Loop) X(JumpZero) X(JumpEq) X(JumpNe) X(JumpLt) X(JumpGt) X(JumpLe) X(JumpGe)                              \
+  X(Call) X(TailCall) X(Ret) X(RetVoid) X(WriteLn) X(ReadLn) X(Halt)
+
+/*
+ * Runs a program without LLVM. The AST is lowered to a register bytecode, one
+ * frame of 32-bit registers per call, which a threaded dispatch loop executes
+ * (computed goto where the compiler supports it, a switch otherwise).
+ * Semantics follow the LLVM code generator: wrapping 32-bit arithmetic,
+ * comparisons yielding 0 or 1, and/or of comparisons short-circuiting in
+ * conditions, the for loop bound evaluated once, tail calls in constant
+ * stack, and the same errors for undeclared names.
+ */
+class Interpreter
+{
+public:
+  enum class Opcode : std::uint8_t
+  {
+#define MILA_OPCODE_ENUM(name) name,
+    MILA_OPCODES(MILA_OPCODE_ENUM)
+#undef MILA_OPCODE_ENUM
+  };
+
+  struct Instruction
+  {
+    Opcode op;
+    std::int32_t a, b, c;
+  };
+
+  // lowers the whole program, throws std::logic_error where code generation would
+  explicit Interpreter(const ProgramASTNode &program);
+  // runs main and returns its result; throws std::runtime_error on division by zero or stack overflow
+  int run();
+
+  // native code is called through a switch over the arity, longer parameter lists stay interpreted
+  static constexpr unsigned maxNativeArity = 6;
+
+  /*
+   * Tiering: once a function other than main has been called or has run a
+   * loop iteration `threshold` times, run() passes its index to `onHot` on
+   * the interpreting thread. Code published with setNative, from any thread,
+   * is used from the next call of the function on; a running interpreted
+   * call finishes in the interpreter.
+   */
+  void enableTiering(std::uint32_t threshold, std::function<void(std::uint32_t)> onHot);
+  // `entry` has the C signature of the function: int or void, maxNativeArity int arguments at most
+  void setNative(std::uint32_t function, void *entry);
+  SymbolId functionName(std::uint32_t function) const { return m_Functions[function].name; }
+  unsigned functionParams(std::uint32_t function) const { return m_Functions[function].params; }
+
+private:
+  class Lowering;
+
+  struct Function
+  {
+    std::uint32_t entry = 0;     // index of the first instruction
+    std::uint32_t frameSize = 1; // registers: arguments, variables, temporaries
+    std::uint32_t params = 0;
+    bool returnsValue = false;
+    bool defined = false;
+    SymbolId name = 0;
+  };
+
+  void reportHot(std::uint32_t function);
+
+  // registers of all frames together; native code gets the 8 MB of a default stack, this is as deep
+  static constexpr std::size_t stackRegisters = std::size_t(1) << 21;
+
+  std::vector<Instruction> m_Code;
+  std::vector<Function> m_Functions;
+  std::uint32_t m_Main = 0;
+
+  std::vector<std::uint32_t> m_Counters;            // calls and loop iterations per function
+  std::unique_ptr<std::atomic<void *>[]> m_Native; // published native code per function, null until compiled
+  std::uint32_t m_Threshold = 0;                   // 0: tiering off
+  std::function<void(std::uint32_t)> m_OnHot;
+};
+
+#endif // PJPPROJECT_INTERPRETER_HPP
@@ -0,0 +1,67 @@
+#include "Jit.hpp"
+#include "Emitter.hpp"
+
+#include <stdexcept>
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/Support/TargetSelect.h>
+
+extern "C" {
+int mila_rt_writeln(int x);
+int mila_rt_write(int x);
+long long mila_rt_readln(void);
+}
+
+template <typename T>
+static T unwrap(llvm::Expected<T> value, const char *what)
+{
+    if (!value)
+        throw std::runtime_error(std::string(what) + ": " + llvm::toString(value.takeError()));
+    return std::move(*value);
+}
+
+static void check(llvm::Error error, const char *what)
+{
+    if (error)
+        throw std::runtime_error(std::string(what) + ": " + llvm::toString(std::move(error)));
+}
+
+std::unique_ptr<llvm::orc::LLJIT> createJit(unsigned optLevel)
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    llvm::orc::JITTargetMachineBuilder machine = unwrap(llvm::orc::JITTargetMachineBuilder::detectHost(), "Cannot detect the host");
+    machine.setCodeGenOptLevel(codeGenLevel(optLevel));
+    machine.getOptions().GuaranteedTailCallOpt = true; // as in createHostTargetMachine
+    std::unique_ptr<llvm::orc::LLJIT> jit =
+        unwrap(llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(machine)).create(), "Cannot create the JIT");
+
+    llvm::orc::JITDylib &library = jit->getMainJITDylib();
+    llvm::JITSymbolFlags flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+    llvm::orc::SymbolMap runtime;
+    runtime[jit->mangleAndIntern("writeln")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&mila_rt_writeln), flags);
+    runtime[jit->mangleAndIntern("write")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&mila_rt_write), flags);
+    runtime[jit->mangleAndIntern("readln")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&mila_rt_readln), flags);
+    check(library.define(llvm::orc::absoluteSymbols(std::move(runtime))), "Cannot define the runtime");
+    // anything else the backend calls (memset, ...) comes from the compiler process
+    library.addGenerator(unwrap(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(jit->getDataLayout().getGlobalPrefix()),
+                                "Cannot search the compiler process"));
+    return jit;
+}
+
+void *jitCompile(llvm::orc::LLJIT &jit, std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module,
+                 llvm::StringRef name)
+{
+    check(jit.addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))), "Cannot add the module");
+    llvm::JITEvaluatedSymbol symbol = unwrap(jit.lookup(name), "Cannot compile");
+    return llvm::jitTargetAddressToPointer<void *>(symbol.getAddress());
+}
+
+int runModule(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module, unsigned optLevel)
+{
+    std::unique_ptr<llvm::orc::LLJIT> jit = createJit(optLevel);
+    void *main = jitCompile(*jit, std::move(context), std::move(module), "main");
+    return reinterpret_cast<int (*)()>(main)();
+}
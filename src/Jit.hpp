@@ -0,0 +1,28 @@
+#ifndef PJPPROJECT_JIT_HPP
+#define PJPPROJECT_JIT_HPP
+
+#include <memory>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+/*
+ * LLJIT for the host, code generation tuned for -O<optLevel>. writeln, write
+ * and readln resolve to the runtime compiled into the compiler
+ * (runtime_jit.c), anything else to the compiler process.
+ */
+std::unique_ptr<llvm::orc::LLJIT> createJit(unsigned optLevel);
+
+// compiles `module` in `jit` and returns the address of its symbol `name`
+void *jitCompile(llvm::orc::LLJIT &jit, std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module,
+                 llvm::StringRef name);
+
+/*
+ * Compiles `module` in memory with createJit(optLevel) and calls its main.
+ * Returns main's result. Throws std::runtime_error if the module cannot be
+ * compiled or has no main.
+ */
+int runModule(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module, unsigned optLevel);
+
+#endif // PJPPROJECT_JIT_HPP
@@ -1,24 +1,166 @@
 #include "Lexer.hpp"
 
+#include <array>
+#include <cstdint>
+
+namespace
+{
+struct Keyword
+{
+    std::string_view text;
+    int token;
+};
+
+constexpr Keyword keywords[] = {
+    {"array", tok_array},
+    {"downto", tok_downto},
+    {"to", tok_to},
+    {"and", tok_and},
+    {"not", tok_not},
+    {"div", tok_div},
+    {"mod", tok_mod},
+    {"or", tok_or},
+    {"begin", tok_begin},
+    {"end", tok_end},
+    {"const", tok_const},
+    {"procedure", tok_procedure},
+    {"forward", tok_forward},
+    {"function", tok_function},
+    {"if", tok_if},
+    {"then", tok_then},
+    {"else", tok_else},
+    {"program", tok_program},
+    {"while", tok_while},
+    {"exit", tok_exit},
+    {"var", tok_var},
+    {"integer", tok_integer},
+    {"for", tok_for},
+    {"do", tok_do},
+    {"break", tok_break},
+};
+
+constexpr unsigned keywordTableBits = 6;
+constexpr std::size_t keywordTableSize = std::size_t(1) << keywordTableBits;
+
+// length, first two and last character are enough to tell the keywords apart
+constexpr std::uint32_t keywordKey(std::string_view word)
+{
+    return std::uint32_t(word.size()) ^ (std::uint32_t(static_cast<unsigned char>(word[0])) << 8) ^
+           (std::uint32_t(static_cast<unsigned char>(word[word.size() > 1 ? 1 : 0])) << 16) ^
+           (std::uint32_t(static_cast<unsigned char>(word[word.size() - 1])) << 24);
+}
+
+constexpr std::size_t keywordSlot(std::uint32_t key, std::uint32_t seed)
+{
+    return std::uint32_t(key * seed) >> (32 - keywordTableBits);
+}
+
 /**
- * @brief Function to return the next token from standard input
+ * @brief Finds a multiplier that maps every keyword to its own slot
  *
- * the variable 'm_IdentifierStr' is set there in case of an identifier,
+ * Evaluated by the compiler, the search never runs at lexing time.
+ */
+constexpr std::uint32_t findKeywordSeed()
+{
+    for (std::uint32_t seed = 0x9E3779B1u;; seed += 2)
+    {
+        bool used[keywordTableSize] = {};
+        bool collision = false;
+        for (const Keyword &keyword : keywords)
+        {
+            std::size_t slot = keywordSlot(keywordKey(keyword.text), seed);
+            collision = collision || used[slot];
+            used[slot] = true;
+        }
+        if (!collision)
+            return seed;
+    }
+}
+
+constexpr std::uint32_t keywordSeed = findKeywordSeed();
+
+constexpr std::array<Keyword, keywordTableSize> buildKeywordTable()
+{
+    std::array<Keyword, keywordTableSize> table{};
+    for (const Keyword &keyword : keywords)
+        table[keywordSlot(keywordKey(keyword.text), keywordSeed)] = keyword;
+    return table;
+}
+
+// perfect hash table, empty slots hold an empty text that never matches a word
+constexpr std::array<Keyword, keywordTableSize> keywordTable = buildKeywordTable();
+} // namespace
+
+/**
+ * @brief Loads the whole source into memory
+ *
+ * Regular files are memory-mapped, "-" reads standard input in chunks.
+ * The lexer then only moves a cursor over the contiguous buffer.
+ */
+Lexer::Lexer(const std::string &fileName)
+{
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer = llvm::MemoryBuffer::getFileOrSTDIN(fileName);
+    if (!buffer)
+        throw std::runtime_error("Cannot read " + fileName + ": " + buffer.getError().message());
+    m_Buffer = std::move(*buffer);
+    m_Cur = m_Buffer->getBufferStart();
+    m_End = m_Buffer->getBufferEnd();
+    m_TokStart = m_LineStart = m_Cur;
+}
+
+/**
+ * @brief Lexes the whole source at once
+ *
+ * The parser then walks the returned buffer instead of calling gettok.
+ */
+TokenBuffer Lexer::tokenize()
+{
+    TokenBuffer tokens;
+    // Mila sources average a token every 3-4 bytes
+    tokens.reserve(m_Buffer->getBufferSize() / 3 + 1);
+    while (true)
+    {
+        int token = gettok();
+        std::uint32_t payload = 0;
+        if (token == tok_identifier)
+            payload = m_Identifier;
+        else if (token == tok_number)
+            payload = static_cast<std::uint32_t>(m_NumVal);
+        tokens.push(token, payload, m_TokStart - m_Buffer->getBufferStart(), m_Line, m_TokStart - m_LineStart + 1);
+        if (token == tok_eof)
+            return tokens;
+    }
+}
+
+std::string Lexer::location() const
+{
+    return std::to_string(m_Line) + ":" + std::to_string(m_TokStart - m_LineStart + 1);
+}
+
+/**
+ * @brief Function to return the next token from the source buffer
+ *
+ * the variable 'm_Identifier' is set there in case of an identifier (interned in the global SymbolPool),
  * the variable 'm_NumVal' is set there in case of a number.
  */
 int Lexer::gettok()
 {
-    std::string word = "";
+    const char *wordStart = nullptr;
 Start:
-    char c = std::cin.peek();
+    m_TokStart = m_Cur;
+    int c = peek();
     if(c == EOF)
     {
-        std::cin.get();
+        get();
         return tok_eof;
     }
     if(std::isspace(c))
     {
-        std::cin.get();
+        if (get() == '\n')
+        {
+            ++m_Line;
+            m_LineStart = m_Cur;
+        }
         goto Start;
     }
     if(std::isdigit(c))
@@ -27,64 +169,64 @@ Start:
     }
     if(std::isalpha(c))
     {
-        word += std::cin.get();
+        wordStart = m_Cur++;
         goto Word;
     }
     switch (c)
     {
         case '+':
-            std::cin.get();
+            get();
             return '+';
         case ',':
-            std::cin.get();
+            get();
             return ',';
         case '.':
-            std::cin.get();
+            get();
             return '.';
         case '-':
-            std::cin.get();
+            get();
             return '-';
         case '*':
-            std::cin.get();
+            get();
             return '*';
         case '(':
-            std::cin.get();
+            get();
             return '(';
         case ')':
-            std::cin.get();
+            get();
             return ')';
         case '[':
-            std::cin.get();
+            get();
             return '[';
         case ']':
-            std::cin.get();
+            get();
             return ']';
         case '>':
-            std::cin.get();
+            get();
             goto Greater;
         case '<':
-            std::cin.get();
+            get();
             goto LessThan;
         case ':':
-            std::cin.get();
-            if(std::cin.peek()=='=')
+            get();
+            if(peek()=='=')
             {
-                std::cin.get();
+                get();
                 return tok_assign;
             }
             else
                 return ':';
         case ';':
-            std::cin.get();
+            get();
             return ';';      
         case '$':
-            std::cin.get();
+            get();
             goto Hexa;
         case '&':  
-            std::cin.get();
+            get();
             goto Octa;
         case '=':
-            std::cin.get();
+            get();
             return '=';
     }
 
@@ -95,87 +237,35 @@ Octa:
 Hexa:
     return readNumber(16);
 Greater:
-    if(std::cin.peek() == '=')
+    if(peek() == '=')
     {
-        std::cin.get();
+        get();
         return tok_greaterequal;
     }
     return '>';
 LessThan:
-    if(std::cin.peek() == '=')
+    if(peek() == '=')
     {
-        std::cin.get();
+        get();
         return tok_lessequal;
     }
-    else if(std::cin.peek() == '>')
+    else if(peek() == '>')
     {
-        std::cin.get();
+        get();
         return tok_notequal;
     }
     return '<';
 Word:
-    if(isalnum(std::cin.peek()) || std::cin.peek() == '_')
-    {
-        word += std::cin.get();
-        goto Word;
-    }
-
-    if ( word == "array")
-        return tok_array;
-    else if (word == "downto")
-        return tok_downto;
-    else if (word == "to")
-        return tok_to;
-    else if (word == "and")
-        return tok_and;
-    else if (word == "not")
-        return tok_not;
-    else if (word == "div")
-        return tok_div;
-    else if (word == "mod")
-        return tok_mod;
-    else if (word == "or")
-        return tok_or;
-    else if (word == "begin")
-        return tok_begin;
-    else if (word == "end")
-        return tok_end;
-    else if (word == "const")
-        return tok_const;
-    else if (word == "procedure")
-        return tok_procedure;
-    else if (word == "forward")
-        return tok_forward;
-    else if( word == "function")
-        return tok_function;
-    else if (word == "if")
-        return tok_if;
-    else if (word == "then")
-        return tok_then;
-    else if(word == "else")
-        return tok_else;
-    else if (word == "program")
-        return tok_program;
-    else if (word == "while")
-        return tok_while;
-    else if ( word == "exit")
-        return tok_exit;
-    else if ( word == "var" )
-        return tok_var;
-    else if ( word == "integer" )
-        return tok_integer;
-    else if ( word == "for" )
-        return tok_for;
-    else if ( word == "do" )
-        return tok_do;
-    else if ( word == "break")
-        return tok_break;
-    else
+    while(isalnum(peek()) || peek() == '_')
+        ++m_Cur;
     {
-        m_IdentifierStr = word;
+        std::string_view word(wordStart, m_Cur - wordStart);
+        const Keyword &keyword = keywordTable[keywordSlot(keywordKey(word), keywordSeed)];
+        if (keyword.text == word)
+            return keyword.token;
+        m_Identifier = SymbolPool::global().intern(word);
         return tok_identifier;
     }
-
 }
 
 bool Lexer::isDigitCorrect(char num ,int base,int& value)
@@ -195,19 +285,19 @@ bool Lexer::isDigitCorrect(char num ,int base,int& value)
 
 int Lexer::readNumber(int base)
 {
-    char current = std::cin.get();
+    char current = get();
     m_NumVal = current - '0';
     while(true)
     {
         int nextValue = 0;
-        char next = std::cin.peek();
+        int next = peek();
         if(!isalnum(next))
             break;
         if(!isDigitCorrect(next,base,nextValue))
         {
-            throw std::runtime_error("Not Correct Digit for the base");
+            throw std::runtime_error(location() + ": Not Correct Digit for the base");
         }
-        std::cin.get();
+        get();
         m_NumVal = m_NumVal * base + nextValue;
     }
     return tok_number;
@@ -1,8 +1,19 @@
 #ifndef PJPPROJECT_LEXER_HPP
 #define PJPPROJECT_LEXER_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "SymbolPool.hpp"
 
 /*
  * Lexer returns tokens [0-255] if it is an unknown character, otherwise one of these for known things.
@@ -58,21 +69,115 @@ enum Token
     tok_break = -34
 };
 
+// every token the lexer produces lies in [tokenMin, tokenMax], single characters are plain ASCII
+constexpr int tokenMin = tok_break;
+constexpr int tokenMax = 127;
+constexpr std::size_t tokenCount = tokenMax - tokenMin + 1;
+
+// dense index of a token into the token tables
+constexpr std::size_t tokenIndex(int token) { return static_cast<std::size_t>(token - tokenMin); }
+
+constexpr std::array<std::string_view, tokenCount> buildTokenNames()
+{
+    constexpr std::string_view named[] = {
+        "tok_eof", "tok_identifier", "tok_number", "tok_begin", "tok_end", "tok_const",
+        "tok_procedure", "tok_forward", "tok_function", "tok_if", "tok_then", "tok_else",
+        "tok_program", "tok_while", "tok_exit", "tok_var", "tok_integer", "tok_for",
+        "tok_do", "tok_notequal", "tok_lessequal", "tok_greaterequal", "tok_assign", "tok_or",
+        "tok_mod", "tok_div", "tok_not", "tok_and", "tok_xor", "tok_to",
+        "tok_downto", "tok_array", "tok_readln", "tok_break"};
+    // spelling of every single-character token, indexed by the character
+    constexpr std::string_view ascii =
+        "                                "
+        " !\"#$%&'()*+,-./0123456789:;<=>?"
+        "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_"
+        "`abcdefghijklmnopqrstuvwxyz{|}~ ";
+
+    std::array<std::string_view, tokenCount> names{};
+    for (int token = tok_eof; token >= tokenMin; --token)
+        names[tokenIndex(token)] = named[-token - 1];
+    for (int c = 0; c <= tokenMax; ++c)
+        names[tokenIndex(c)] = ascii.substr(c, 1);
+    return names;
+}
+
+inline constexpr std::array<std::string_view, tokenCount> tokenNames = buildTokenNames();
+
+// printable name of a token, for diagnostics and debugging
+constexpr std::string_view tokenName(int token)
+{
+    return token >= tokenMin && token <= tokenMax ? tokenNames[tokenIndex(token)] : std::string_view("<unknown>");
+}
+
+
+/*
+ * Every token of a source file, lexed once and stored as a structure of arrays:
+ * token i is described by kinds[i], payloads[i], offsets[i], lines[i] and columns[i].
+ */
+struct TokenBuffer
+{
+    std::vector<std::int8_t> kinds;      // Token value, or the character itself for single-character tokens
+    std::vector<std::uint32_t> payloads; // SymbolId for tok_identifier, the value for tok_number
+    std::vector<std::uint32_t> offsets;  // byte offset into the source
+    std::vector<std::uint32_t> lines;    // 1-based
+    std::vector<std::uint32_t> columns;  // 1-based
+
+    static constexpr size_t bytesPerToken =
+        sizeof(std::int8_t) + sizeof(std::uint32_t) * 4;
+
+    size_t size() const { return kinds.size(); }
+    // heap bytes held by the arrays, including spare capacity
+    size_t memoryUsage() const
+    {
+        return kinds.capacity() * sizeof(kinds[0]) + payloads.capacity() * sizeof(payloads[0]) +
+               offsets.capacity() * sizeof(offsets[0]) + lines.capacity() * sizeof(lines[0]) +
+               columns.capacity() * sizeof(columns[0]);
+    }
+
+    void reserve(size_t count)
+    {
+        kinds.reserve(count);
+        payloads.reserve(count);
+        offsets.reserve(count);
+        lines.reserve(count);
+        columns.reserve(count);
+    }
+
+    void push(int kind, std::uint32_t payload, std::uint32_t offset, std::uint32_t line, std::uint32_t column)
+    {
+        kinds.push_back(static_cast<std::int8_t>(kind));
+        payloads.push_back(payload);
+        offsets.push_back(offset);
+        lines.push_back(line);
+        columns.push_back(column);
+    }
+};
 
 class Lexer
 {
 public:
-    Lexer() = default;
+    Lexer(const std::string &fileName = "-");
     ~Lexer() = default;
 
     int gettok();
-    const std::string &identifierStr() const { return this->m_IdentifierStr; }
+    TokenBuffer tokenize();
+    SymbolId identifier() const { return this->m_Identifier; }
     int numVal() { return this->m_NumVal; }
 
 private:
-    std::string m_IdentifierStr;
+    std::unique_ptr<llvm::MemoryBuffer> m_Buffer; // whole source, mmap-ed for files
+    const char *m_Cur = nullptr;                   // cursor into m_Buffer
+    const char *m_End = nullptr;
+    const char *m_TokStart = nullptr;  // first character of the last token
+    const char *m_LineStart = nullptr; // first character of the current line
+    std::uint32_t m_Line = 1;
+    SymbolId m_Identifier;
     int m_NumVal;
 
+    int peek() const { return m_Cur < m_End ? static_cast<unsigned char>(*m_Cur) : EOF; }
+    int get() { return m_Cur < m_End ? static_cast<unsigned char>(*m_Cur++) : EOF; }
+
+    std::string location() const;
     int readNumber(int);
     bool isDigitCorrect(char,int,int&);
 };
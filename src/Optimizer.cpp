@@ -0,0 +1,125 @@
+#include "Optimizer.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+
+#if LLVM_VERSION_MAJOR >= 14
+using llvm::OptimizationLevel;
+#else
+using OptimizationLevel = llvm::PassBuilder::OptimizationLevel;
+#endif
+
+static OptimizationLevel optimizationLevel(unsigned level)
+{
+    switch (level)
+    {
+    case 1:
+        return OptimizationLevel::O1;
+    case 2:
+        return OptimizationLevel::O2;
+    case 3:
+        return OptimizationLevel::O3;
+    default:
+        throw std::invalid_argument("Unknown optimization level " + std::to_string(level));
+    }
+}
+
+void optimizeModule(llvm::Module &module, unsigned level, llvm::TargetMachine *target)
+{
+    if (level == 0)
+        return;
+
+    std::string problems;
+    llvm::raw_string_ostream problemStream(problems);
+    if (llvm::verifyModule(module, &problemStream))
+        throw std::logic_error("Generated invalid IR: " + problemStream.str());
+
+    // the analysis managers must outlive the pass manager using them, and be destroyed in reverse
+    llvm::LoopAnalysisManager loopAnalyses;
+    llvm::FunctionAnalysisManager functionAnalyses;
+    llvm::CGSCCAnalysisManager cgsccAnalyses;
+    llvm::ModuleAnalysisManager moduleAnalyses;
+
+#if LLVM_VERSION_MAJOR >= 13
+    llvm::PassBuilder passBuilder(target);
+#else
+    llvm::PassBuilder passBuilder(false, target);
+#endif
+    passBuilder.registerModuleAnalyses(moduleAnalyses);
+    passBuilder.registerCGSCCAnalyses(cgsccAnalyses);
+    passBuilder.registerFunctionAnalyses(functionAnalyses);
+    passBuilder.registerLoopAnalyses(loopAnalyses);
+    passBuilder.crossRegisterProxies(loopAnalyses, functionAnalyses, cgsccAnalyses, moduleAnalyses);
+
+    llvm::ModulePassManager passes = passBuilder.buildPerModuleDefaultPipeline(optimizationLevel(level));
+    passes.run(module, moduleAnalyses);
+}
+
+void internalizeFunctions(llvm::Module &module, llvm::Function *entry)
+{
+    for (llvm::Function &function : module)
+    {
+        if (function.isDeclaration() || &function == entry)
+            continue;
+        function.setLinkage(llvm::GlobalValue::InternalLinkage);
+        function.setCallingConv(llvm::CallingConv::Fast);
+    }
+    for (llvm::Function &function : module)
+        for (llvm::Instruction &instruction : llvm::instructions(function))
+        {
+            auto *call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+            llvm::Function *callee = call ? call->getCalledFunction() : nullptr;
+            if (!callee)
+                continue;
+            call->setCallingConv(callee->getCallingConv());
+            // musttail needs the caller's calling convention too
+            if (call->isMustTailCall() && function.getCallingConv() != callee->getCallingConv())
+                call->setTailCallKind(llvm::CallInst::TCK_Tail);
+        }
+}
+
+bool linkRuntime(llvm::Module &module)
+{
+#ifdef MILA_RUNTIME_BITCODE
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer = llvm::MemoryBuffer::getFile(MILA_RUNTIME_BITCODE);
+    if (!buffer)
+        throw std::runtime_error(std::string("Cannot read " MILA_RUNTIME_BITCODE ": ") + buffer.getError().message());
+    llvm::Expected<std::unique_ptr<llvm::Module>> runtime = llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), module.getContext());
+    if (!runtime)
+        throw std::runtime_error(std::string("Cannot read " MILA_RUNTIME_BITCODE ": ") + llvm::toString(runtime.takeError()));
+
+    // compiled for the same host by clang; the target machine decides CPU and features like for the generated
+    // code, clang's attributes would only keep the inliner from mixing the two
+    (*runtime)->setTargetTriple(module.getTargetTriple());
+    (*runtime)->setDataLayout(module.getDataLayout());
+    for (llvm::Function &function : **runtime)
+    {
+        function.removeFnAttr("target-cpu");
+        function.removeFnAttr("target-features");
+        function.removeFnAttr("tune-cpu");
+    }
+
+    auto internalize = [](llvm::Module &linked, const llvm::StringSet<> &runtimeNames) {
+        llvm::internalizeModule(linked, [&runtimeNames](const llvm::GlobalValue &value) {
+            return !value.hasName() || !runtimeNames.count(value.getName());
+        });
+    };
+    if (llvm::Linker::linkModules(module, std::move(*runtime), llvm::Linker::Flags::LinkOnlyNeeded, internalize))
+        throw std::runtime_error("Cannot link the runtime");
+    return true;
+#else
+    (void)module;
+    return false;
+#endif
+}
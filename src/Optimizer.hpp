@@ -0,0 +1,37 @@
+#ifndef PJPPROJECT_OPTIMIZER_HPP
+#define PJPPROJECT_OPTIMIZER_HPP
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+/*
+ * Runs the LLVM new pass manager's default pipeline for -O<level> on a
+ * generated module, in place. Level 0 leaves the module untouched. With a
+ * target machine the passes get its cost model (TargetTransformInfo).
+ *
+ * The module is verified first; invalid IR is reported as std::logic_error
+ * instead of being handed to the passes.
+ */
+void optimizeModule(llvm::Module &module, unsigned level, llvm::TargetMachine *target = nullptr);
+
+/*
+ * Links the runtime (fce.c, compiled to bitcode by CMake) into a generated
+ * module that already carries its target's triple and data layout. Only the
+ * functions the module calls are linked, and they become internal, so the
+ * optimizer can inline writeln and readln and see what they touch. Returns
+ * false, leaving the module alone, if the compiler was built without the
+ * bitcode. Throws std::runtime_error if the bitcode cannot be read.
+ */
+bool linkRuntime(llvm::Module &module);
+
+/*
+ * Gives every function defined in the module except `entry` internal linkage
+ * and the fast calling convention, and updates the calls. With a target
+ * machine set up for GuaranteedTailCallOpt, as createHostTargetMachine and
+ * createJit do, every tail call between two of these functions then reuses
+ * the caller's frame, also when their prototypes differ. A musttail call from
+ * `entry`, which keeps the C convention for its callers, becomes a plain tail call.
+ */
+void internalizeFunctions(llvm::Module &module, llvm::Function *entry);
+
+#endif // PJPPROJECT_OPTIMIZER_HPP
@@ -1,15 +1,22 @@
 #include "Parser.hpp"
 #include "ast.hpp"
 
-Parser::Parser()
+#include <llvm/Support/ThreadPool.h>
+
+Parser::Parser(const std::string &fileName) : m_Lexer(std::in_place, fileName), m_Tokens(m_OwnTokens), m_Arena(m_OwnArena)
+{
+}
+
+Parser::Parser(const TokenBuffer &tokens, Arena &arena) : m_Tokens(tokens), m_Arena(arena)
 {
 }
 
-bool Parser::Parse()
+bool Parser::Parse(unsigned jobs, bool lazy)
 {
-    // getNextToken();
-    // while(CurTok!=tok_eof)
-    //     getNextToken();
+    m_OwnTokens = m_Lexer->tokenize();
+    m_Jobs = jobs;
+    m_Lazy = lazy;
+    m_Pos = npos;
     astRoot = parseProgram();
     // astRoot->print(1);
     if (!astRoot)
@@ -17,22 +24,22 @@ bool Parser::Parse()
     return true;
 }
 
-std::unique_ptr<BlockStatmentASTNode> Parser::parseBlockStatement()
+BlockStatmentASTNode *Parser::parseBlockStatement()
 {
-    std::vector<std::unique_ptr<ExprASTNode>> expressions;
+    llvm::SmallVector<ExprASTNode *, 8> expressions;
     while (CurTok != tok_end)
     {
         switch (CurTok)
         {
         case tok_identifier:
-            std::unique_ptr<ExprASTNode> expression = parseIdentiferExpression();
-            expressions.push_back(std::move(expression));
+            ExprASTNode *expression = parseIdentiferExpression();
+            expressions.push_back(expression);
         }
     }
-    return std::make_unique<BlockStatmentASTNode>(std::move(expressions));
+    return m_Arena.make<BlockStatmentASTNode>(m_Arena.copy<ExprASTNode *>(expressions));
 }
 
-void Parser::parseVariableDeclarationBLock(std::vector<std::unique_ptr<VariableDeclarationASTNode>> &statements)
+void Parser::parseVariableDeclarationBLock(llvm::SmallVectorImpl<VariableDeclarationASTNode *> &statements)
 {
     while (CurTok == tok_identifier)
     {
@@ -40,48 +47,48 @@ void Parser::parseVariableDeclarationBLock(std::vector<std::unique_ptr<VariableD
     }
 }
 
-void Parser::parseConstantDeclarationBlock(std::vector<std::unique_ptr<ConstantDeclarationASTNode>> &statments)
+void Parser::parseConstantDeclarationBlock(llvm::SmallVectorImpl<ConstantDeclarationASTNode *> &statments)
 {
     while (CurTok == tok_identifier)
     {
-        std::unique_ptr<ConstantDeclarationASTNode> declaration = parseConstantDeclaration();
-        statments.push_back(std::move(declaration));
+        ConstantDeclarationASTNode *declaration = parseConstantDeclaration();
+        statments.push_back(declaration);
     }
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseNumberExpression()
+ExprASTNode *Parser::parseNumberExpression()
 {
-    std::unique_ptr<NumberASTNode> result = std::make_unique<NumberASTNode>(m_Lexer.numVal());
+    NumberASTNode *result = m_Arena.make<NumberASTNode>(curNumber());
     getNextToken(); // eat number
     return result;
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseParentheseExpression()
+ExprASTNode *Parser::parseParentheseExpression()
 {
     getNextToken(); // eat (
-    std::unique_ptr<ExprASTNode> expression = parseExpression();
+    ExprASTNode *expression = parseExpression();
     if (!expression)
         return nullptr;
     if (CurTok != ')')
-        throw std::logic_error("Missing paranthesis");
+        error("Missing paranthesis");
     getNextToken(); // eat )
     return expression;
 }
 
-std::unique_ptr<UnaryOperationASTNode> Parser::parseUnaryExpression()
+UnaryOperationASTNode *Parser::parseUnaryExpression()
 {
     int optoken = CurTok;
     getNextToken(); // eat operator
-    std::unique_ptr<ExprASTNode> expression = parseExpression();
-    return std::make_unique<UnaryOperationASTNode>(optoken, std::move(expression));
+    ExprASTNode *expression = parseExpression();
+    return m_Arena.make<UnaryOperationASTNode>(optoken, expression);
 }
 
-std::unique_ptr<ExprASTNode> Parser::parsePrimary()
+ExprASTNode *Parser::parsePrimary()
 {
     switch (CurTok)
     {
     default:
-        throw std::logic_error("unknown token when expecting an expression");
+        error("unknown token when expecting an expression");
     case tok_identifier:
         return parseIdentiferExpression();
     case tok_number:
@@ -97,69 +104,75 @@ std::unique_ptr<ExprASTNode> Parser::parsePrimary()
 
 int Parser::GetTokPrecedence()
 {
-    int currentTokenPrecedence = BinopPrecedence[CurTok];
+    int currentTokenPrecedence = BinopPrecedence[tokenIndex(CurTok)];
     if (currentTokenPrecedence <= 0)
         return -1;
     return currentTokenPrecedence;
 }
 
-std::unique_ptr<ExprASTNode> Parser::ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprASTNode> LHS)
+/**
+ * @brief Parses a chain of binary operators following LHS
+ *
+ * Precedence climbing with explicit operand and operator stacks instead of a
+ * recursive call per precedence level: the stacks only ever hold operators of
+ * strictly increasing precedence, so long chains parse in linear time and
+ * constant native stack. All operators are left associative.
+ */
+ExprASTNode *Parser::ParseBinOpRHS(ExprASTNode *LHS)
 {
-    // If this is a binop, find its precedence.
-    while (true)
-    {
-        int TokPrec = GetTokPrecedence();
+    llvm::SmallVector<ExprASTNode *, 8> operands;
+    llvm::SmallVector<int, 8> operators;
+    operands.push_back(LHS);
+
+    // fold the topmost operator with its two operands
+    auto reduce = [&]() {
+        ExprASTNode *RHS = operands.pop_back_val();
+        ExprASTNode *left = operands.pop_back_val();
+        operands.push_back(m_Arena.make<BinaryOperationASTNode>(operators.pop_back_val(), left, RHS));
+    };
 
-        // if current token is binary operator we need to continue , otherwise
-        //  parsing the expression is done
-        if (TokPrec < ExprPrec)
-            return LHS;
+    int TokPrec;
+    while ((TokPrec = GetTokPrecedence()) > 0)
+    {
+        // operators binding at least as tightly as this one already have both operands
+        while (!operators.empty() && BinopPrecedence[tokenIndex(operators.back())] >= TokPrec)
+            reduce();
 
-        // Okay, we know this is a binop.
-        int BinOp = CurTok;
+        operators.push_back(CurTok);
         getNextToken(); // eat binop
 
         // Parse the primary expression after the binary operator.
-        auto RHS = parsePrimary();
+        ExprASTNode *RHS = parsePrimary();
         if (!RHS)
             return nullptr;
-
-        // If BinOp binds less tightly with RHS than the operator after RHS, let
-        // the pending operator take RHS as its LHS.
-        int NextPrec = GetTokPrecedence();
-        if (TokPrec < NextPrec)
-        {
-            RHS = ParseBinOpRHS(TokPrec + 1, std::move(RHS));
-            if (!RHS)
-                return nullptr;
-        }
-
-        // Merge LHS/RHS.
-        LHS =
-            std::make_unique<BinaryOperationASTNode>(BinOp, std::move(LHS), std::move(RHS));
+        operands.push_back(RHS);
     }
+
+    while (!operators.empty())
+        reduce();
+    return operands.back();
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseExpression()
+ExprASTNode *Parser::parseExpression()
 {
     auto LHS = parsePrimary();
     if (!LHS)
         return nullptr;
 
-    return ParseBinOpRHS(0, std::move(LHS));
+    return ParseBinOpRHS(LHS);
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseAssignemntExpression(const std::string identifier)
+ExprASTNode *Parser::parseAssignemntExpression(SymbolId identifier)
 {
-    std::unique_ptr<VariableASTNode> variable = std::make_unique<VariableASTNode>(identifier);
+    VariableASTNode *variable = m_Arena.make<VariableASTNode>(identifier);
     getNextToken(); // eat assigment;
-    std::unique_ptr<ExprASTNode> expression = parseExpression();
-    return std::make_unique<AssignmentASTNode>(std::move(variable), std::move(expression));
+    ExprASTNode *expression = parseExpression();
+    return m_Arena.make<AssignmentASTNode>(variable, expression);
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseIdentiferExpression()
+ExprASTNode *Parser::parseIdentiferExpression()
 {
-    std::string identifier = m_Lexer.identifierStr();
+    SymbolId identifier = curIdentifier();
     getNextToken(); // eat identifier
 
     if (CurTok == tok_assign)
@@ -167,61 +180,61 @@ std::unique_ptr<ExprASTNode> Parser::parseIdentiferExpression()
 
     if (CurTok != '(')
     {
-        return std::make_unique<VariableASTNode>(identifier); // just a variable
+        return m_Arena.make<VariableASTNode>(identifier); // just a variable
     }
-    if(identifier == "dec")
+    if(identifier == SymbolPool::sym_dec)
     {
         getNextToken(); // eat (
-        std::unique_ptr<VariableASTNode> arg = parseVariable();
+        VariableASTNode *arg = parseVariable();
         getNextToken(); // eat )
-        return std::make_unique<DecrementExprASTNode>(std::move(arg));
+        return m_Arena.make<DecrementExprASTNode>(arg);
     }
-    if(identifier == "inc")
+    if(identifier == SymbolPool::sym_inc)
     {
         getNextToken(); // eat (
-        std::unique_ptr<VariableASTNode> arg = parseVariable();
+        VariableASTNode *arg = parseVariable();
         getNextToken(); // eat )
-        return std::make_unique<IncrementExprASTNode>(std::move(arg));
+        return m_Arena.make<IncrementExprASTNode>(arg);
     }
 
-    if (identifier == "readln")
+    if (identifier == SymbolPool::sym_readln)
     {
         getNextToken(); // eat (
-        std::unique_ptr<VariableASTNode> arg = parseVariable();
+        VariableASTNode *arg = parseVariable();
         getNextToken(); // eat )
-        return std::make_unique<ReadlnExprASTNode>(std::move(arg));
+        return m_Arena.make<ReadlnExprASTNode>(arg);
     }
 
     getNextToken(); // eat (
-    std::vector<std::unique_ptr<ExprASTNode>> args;
+    llvm::SmallVector<ExprASTNode *, 8> args;
     if (CurTok != ')')
     {
         while (true)
         {
-            if (std::unique_ptr<ExprASTNode> arg = parseExpression())
-                args.push_back(std::move(arg));
+            if (ExprASTNode *arg = parseExpression())
+                args.push_back(arg);
             else
                 return nullptr;
             if (CurTok == ')')
                 break;
             if (CurTok != ',')
             {
-                throw std::logic_error("Arguemnt should be separated by comma");
+                error("Arguemnt should be separated by comma");
             }
             getNextToken();
         }
     }
     getNextToken(); // eat )
-    return std::make_unique<FunctionCallExprASTNode>(identifier, std::move(args));
+    return m_Arena.make<FunctionCallExprASTNode>(identifier, m_Arena.copy<ExprASTNode *>(args));
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseIfElseExpression()
+ExprASTNode *Parser::parseIfElseExpression()
 {
     getNextToken(); // eat if
-    std::unique_ptr<ExprASTNode> condition = parseExpression();
+    ExprASTNode *condition = parseExpression();
 
     getNextToken(); // eat then
-    std::unique_ptr<ASTNode> then = nullptr;
+    ASTNode *then = nullptr;
     if (CurTok == tok_begin)
     {
         then = parseMainFunctionBlock();
@@ -230,9 +243,9 @@ std::unique_ptr<ExprASTNode> Parser::parseIfElseExpression()
     else
         then = parseExpressionLines();
     if (CurTok != tok_else)
-        return std::make_unique<IfElseASTNode>(std::move(condition), std::move(then), nullptr);
+        return m_Arena.make<IfElseASTNode>(condition, then, nullptr);
     getNextToken(); // eat else
-    std::unique_ptr<ASTNode> elseBranch = nullptr;
+    ASTNode *elseBranch = nullptr;
     if (CurTok == tok_begin)
     {
         elseBranch = parseMainFunctionBlock();
@@ -240,31 +253,31 @@ std::unique_ptr<ExprASTNode> Parser::parseIfElseExpression()
     }
     else
         elseBranch = parseExpressionLines();
-    return std::make_unique<IfElseASTNode>(std::move(condition), std::move(then), std::move(elseBranch));
+    return m_Arena.make<IfElseASTNode>(condition, then, elseBranch);
 }
 
-std::unique_ptr<BreakASTNode> Parser::parseBreak()
+BreakASTNode *Parser::parseBreak()
 {
     getNextToken(); // eat break
-    return std::make_unique<BreakASTNode>();
+    return m_Arena.make<BreakASTNode>();
 }
 
-std::unique_ptr<FunctionExitASTNode> Parser::parseFunctionExit()
+FunctionExitASTNode *Parser::parseFunctionExit()
 {
     getNextToken(); // eat exit
     if (CurTok == ';')
         getNextToken(); // eat ;
-    return std::make_unique<FunctionExitASTNode>();
+    return m_Arena.make<FunctionExitASTNode>();
 }
 
-std::unique_ptr<WhileASTNode> Parser::parseWhile()
+WhileASTNode *Parser::parseWhile()
 {
 
 
     getNextToken(); // eat while
-    std::unique_ptr<ExprASTNode> condition = parseExpression();
+    ExprASTNode *condition = parseExpression();
     getNextToken(); // eat do
-    std::unique_ptr<ASTNode> body = nullptr;
+    ASTNode *body = nullptr;
     if (CurTok == tok_begin)
     {
         
@@ -277,29 +290,29 @@ std::unique_ptr<WhileASTNode> Parser::parseWhile()
 
     
 
-    return std::make_unique<WhileASTNode>(std::move(condition), std::move(body));
+    return m_Arena.make<WhileASTNode>(condition, body);
 }
 
-std::unique_ptr<ForASTNode> Parser::parseForExpression()
+ForASTNode *Parser::parseForExpression()
 {
     getNextToken(); // eat for
-    std::string identifier = m_Lexer.identifierStr();
+    SymbolId identifier = curIdentifier();
     getNextToken(); // eat identifier
-    std::unique_ptr<ExprASTNode> assignment = parseAssignemntExpression(identifier);
+    ExprASTNode *assignment = parseAssignemntExpression(identifier);
     ForASTNode::Type type = ForASTNode::Type::TO;
     if(CurTok == tok_downto) type = ForASTNode::Type::DOWNTO;
     getNextToken(); // down to or to
-    std::unique_ptr<ExprASTNode> expression = parseExpression();
+    ExprASTNode *expression = parseExpression();
     getNextToken(); // eat do
-    std::unique_ptr<ASTNode> body = nullptr;
+    ASTNode *body = nullptr;
     if(CurTok == tok_begin) body = parseMainFunctionBlock();
     else body = parseExpression();
 
 
-    return std::make_unique<ForASTNode>(identifier,std::move(assignment),type,std::move(expression),std::move(body));
+    return m_Arena.make<ForASTNode>(identifier,assignment,type,expression,body);
 }
 
-std::unique_ptr<ExprASTNode> Parser::parseExpressionLines()
+ExprASTNode *Parser::parseExpressionLines()
 {
     switch (CurTok)
     {
@@ -321,49 +334,49 @@ std::unique_ptr<ExprASTNode> Parser::parseExpressionLines()
 }
 
 
-std::unique_ptr<BlockStatmentASTNode> Parser::parseMainFunctionBlock()
+BlockStatmentASTNode *Parser::parseMainFunctionBlock()
 {
     getNextToken(); // eat begin
-    std::vector<std::unique_ptr<ExprASTNode>> expressions;
+    llvm::SmallVector<ExprASTNode *, 8> expressions;
     while (CurTok != tok_end)
     {
-        std::unique_ptr<ExprASTNode> expression = parseExpressionLines();
-        expressions.push_back(std::move(expression));
+        ExprASTNode *expression = parseExpressionLines();
+        expressions.push_back(expression);
         if (CurTok == ';')
             getNextToken(); // eat ;
     }
     getNextToken(); // eat end
     
-    return std::make_unique<BlockStatmentASTNode>(std::move(expressions));
+    return m_Arena.make<BlockStatmentASTNode>(m_Arena.copy<ExprASTNode *>(expressions));
 }
 
-std::unique_ptr<VariableASTNode> Parser::parseVariable()
+VariableASTNode *Parser::parseVariable()
 {
     if (CurTok != tok_identifier)
         return nullptr;
-    const std::string identitfier = m_Lexer.identifierStr();
+    const SymbolId identitfier = curIdentifier();
     getNextToken(); // eat the identitifer
-    return std::make_unique<VariableASTNode>(identitfier);
+    return m_Arena.make<VariableASTNode>(identitfier);
 }
 
-std::unique_ptr<NumberASTNode> Parser::parseNumber()
+NumberASTNode *Parser::parseNumber()
 {
     if (CurTok != tok_number)
         return nullptr;
-    int value = m_Lexer.numVal();
+    int value = curNumber();
     getNextToken(); // eat the number
-    return std::make_unique<NumberASTNode>(value);
+    return m_Arena.make<NumberASTNode>(value);
 }
-void Parser::parseVariableDeclaration(std::vector<std::unique_ptr<VariableDeclarationASTNode>> &statements)
+void Parser::parseVariableDeclaration(llvm::SmallVectorImpl<VariableDeclarationASTNode *> &statements)
 {
-    std::vector<std::string> variables;
-    std::string variable = m_Lexer.identifierStr();
+    llvm::SmallVector<SymbolId, 8> variables;
+    SymbolId variable = curIdentifier();
     getNextToken(); // eat identifer
     variables.push_back(variable);
     while (CurTok != ':')
     {
         getNextToken();  // eat ,
-        variable = m_Lexer.identifierStr();
+        variable = curIdentifier();
         getNextToken();
         variables.push_back(variable);
     }
@@ -372,52 +385,51 @@ void Parser::parseVariableDeclaration(std::vector<std::unique_ptr<VariableDeclar
     getNextToken(); // eat integer
     getNextToken(); // eat ;
 
-    for(auto variable : variables)
+    for(SymbolId variable : variables)
     {
-        std::unique_ptr<VariableDeclarationASTNode> declaration = std::make_unique<VariableDeclarationASTNode>(variable, nullptr);
-        statements.push_back( std::move(declaration));
+        VariableDeclarationASTNode *declaration = m_Arena.make<VariableDeclarationASTNode>(variable, nullptr);
+        statements.push_back( declaration);
     }
 }
 
-std::unique_ptr<ConstantDeclarationASTNode> Parser::parseConstantDeclaration()
+ConstantDeclarationASTNode *Parser::parseConstantDeclaration()
 {
-    std::string variable = m_Lexer.identifierStr();
+    SymbolId variable = curIdentifier();
     getNextToken(); // eat identifier
     if (CurTok != '=')
         return nullptr;
     getNextToken(); // eat =
-    int value = m_Lexer.numVal();
+    int value = curNumber();
     getNextToken();
     if (CurTok != ';')
         return nullptr;
     getNextToken(); // eat ;
-    return std::make_unique<ConstantDeclarationASTNode>(variable, value);
+    return m_Arena.make<ConstantDeclarationASTNode>(variable, value);
 }
 
-std::string Parser::parseFunctionParameter()
+SymbolId Parser::parseFunctionParameter()
 {
-    std::string paraName = m_Lexer.identifierStr();
+    SymbolId paraName = curIdentifier();
     getNextToken(); // eat para
     getNextToken(); // eat :
     getNextToken(); // eat integer
     return paraName;
 }
 
-std::unique_ptr<VariableDeclarationASTNode> Parser::parseReturnValue()
+VariableDeclarationASTNode *Parser::parseReturnValue(SymbolId retrunValueName)
 {
     getNextToken(); // eat identifier
-    std::string retrunValueName = m_Lexer.identifierStr();
-    return std::make_unique<VariableDeclarationASTNode>(retrunValueName, nullptr);
+    return m_Arena.make<VariableDeclarationASTNode>(retrunValueName, nullptr);
 }
 
-std::unique_ptr<PrototypeASTNode> Parser::parseProtoType()
+PrototypeASTNode *Parser::parseProtoType()
 {
     int tokenType = CurTok;
     
     getNextToken(); // eat function
-    std::string functionName = m_Lexer.identifierStr();
-    std::unique_ptr<VariableDeclarationASTNode> returnValue = parseReturnValue();
-    std::vector<std::string> parameters;
+    SymbolId functionName = curIdentifier();
+    VariableDeclarationASTNode *returnValue = parseReturnValue(functionName);
+    llvm::SmallVector<SymbolId, 8> parameters;
     while (CurTok != ')')
     {
         getNextToken();
@@ -429,27 +441,27 @@ std::unique_ptr<PrototypeASTNode> Parser::parseProtoType()
         getNextToken(); // eat :
         getNextToken(); // eat integer;
         getNextToken(); // eat ;
-        return std::make_unique<PrototypeASTNode>(functionName, parameters, PrototypeASTNode::FUNCTION, std::move(returnValue));
+        return m_Arena.make<PrototypeASTNode>(functionName, m_Arena.copy<SymbolId>(parameters), PrototypeASTNode::FUNCTION, returnValue);
     }
     else if (tokenType == tok_procedure)
     {
         getNextToken(); // eat ;
-        return std::make_unique<PrototypeASTNode>(functionName, parameters, PrototypeASTNode::PROCEDURE, std::move(returnValue));
+        return m_Arena.make<PrototypeASTNode>(functionName, m_Arena.copy<SymbolId>(parameters), PrototypeASTNode::PROCEDURE, returnValue);
     }
     return nullptr;
 }
 
-std::unique_ptr<FunctionASTNode> Parser::parseFunction()
+FunctionASTNode *Parser::parseFunction()
 {
-    std::unique_ptr<PrototypeASTNode> prototype = parseProtoType();
+    PrototypeASTNode *prototype = parseProtoType();
 
-    std::vector<std::unique_ptr<VariableDeclarationASTNode>> variables;
-    std::vector<std::unique_ptr<ConstantDeclarationASTNode>> constants;
+    llvm::SmallVector<VariableDeclarationASTNode *, 8> variables;
+    llvm::SmallVector<ConstantDeclarationASTNode *, 8> constants;
     if (CurTok == tok_forward)
     {
         getNextToken(); // eat forward
         getNextToken(); // eat semicolon;
-        return std::make_unique<FunctionASTNode>(std::move(prototype), std::move(variables), std::move(constants), nullptr);
+        return m_Arena.make<FunctionASTNode>(prototype, m_Arena.copy<VariableDeclarationASTNode *>(variables), m_Arena.copy<ConstantDeclarationASTNode *>(constants), nullptr);
     }
 
     while (CurTok == tok_var || CurTok == tok_const)
@@ -466,16 +478,16 @@ std::unique_ptr<FunctionASTNode> Parser::parseFunction()
         }
     }
 
-    std::unique_ptr<BlockStatmentASTNode> mainBlock = parseMainFunctionBlock();
+    BlockStatmentASTNode *mainBlock = parseMainFunctionBlock();
     getNextToken(); // eat semicolon
-    return std::make_unique<FunctionASTNode>(std::move(prototype), std::move(variables), std::move(constants), std::move(mainBlock));
+    return m_Arena.make<FunctionASTNode>(prototype, m_Arena.copy<VariableDeclarationASTNode *>(variables), m_Arena.copy<ConstantDeclarationASTNode *>(constants), mainBlock);
 }
 
-std::unique_ptr<FunctionASTNode> Parser::parseMainFunction()
+FunctionASTNode *Parser::parseMainFunction()
 {
-    std::unique_ptr<PrototypeASTNode> prototype = std::make_unique<PrototypeASTNode>("main", std::vector<std::string>(), PrototypeASTNode::FUNCTION, nullptr);
-    std::vector<std::unique_ptr<VariableDeclarationASTNode>> variables;
-    std::vector<std::unique_ptr<ConstantDeclarationASTNode>> constants;
+    PrototypeASTNode *prototype = m_Arena.make<PrototypeASTNode>(SymbolPool::sym_main, llvm::ArrayRef<SymbolId>(), PrototypeASTNode::FUNCTION, nullptr);
+    llvm::SmallVector<VariableDeclarationASTNode *, 8> variables;
+    llvm::SmallVector<ConstantDeclarationASTNode *, 8> constants;
     while (CurTok == tok_var || CurTok == tok_const)
     {
         if (CurTok == tok_const)
@@ -489,14 +501,14 @@ std::unique_ptr<FunctionASTNode> Parser::parseMainFunction()
             parseVariableDeclarationBLock(variables);
         }
     }
-    std::unique_ptr<BlockStatmentASTNode> mainBlock = parseMainFunctionBlock();
+    BlockStatmentASTNode *mainBlock = parseMainFunctionBlock();
     getNextToken(); // eat .
 
 
-    return std::make_unique<FunctionASTNode>(std::move(prototype), std::move(variables), std::move(constants), std::move(mainBlock));
+    return m_Arena.make<FunctionASTNode>(prototype, m_Arena.copy<VariableDeclarationASTNode *>(variables), m_Arena.copy<ConstantDeclarationASTNode *>(constants), mainBlock);
 }
 
-std::unique_ptr<ProgramASTNode> Parser::parseProgram()
+ProgramASTNode *Parser::parseProgram()
 {
     if (getNextToken() != tok_program)
         return nullptr;
@@ -506,7 +518,8 @@ std::unique_ptr<ProgramASTNode> Parser::parseProgram()
         return nullptr;
     getNextToken();
 
-    std::vector<std::unique_ptr<FunctionASTNode>> functions;
+    llvm::SmallVector<FunctionASTNode *, 8> functions;
+    parseDeclarations(functions);
     while (true)
     {
         int i = 0;
@@ -515,60 +528,298 @@ std::unique_ptr<ProgramASTNode> Parser::parseProgram()
         switch (CurTok)
         {
         case tok_function:
-            functions.push_back(std::move(parseFunction()));
+            functions.push_back(parseFunction());
             break;
         case tok_procedure:
-            functions.push_back(std::move(parseFunction()));
+            functions.push_back(parseFunction());
             break;
         default:
-            functions.push_back(std::move(parseMainFunction()));
+            functions.push_back(parseMainFunction());
             break;
         }
     }
 
-    return std::make_unique<ProgramASTNode>(std::move(functions));
+    return m_Arena.make<ProgramASTNode>(m_Arena.copy<FunctionASTNode *>(functions));
+}
+
+/**
+ * @brief Finds the top-level function and procedure declarations starting at token `pos`
+ *
+ * Only looks at token kinds: a declaration runs up to `forward ;`, or up to the
+ * `end ;` closing its first begin. Stops at the first token that does not start
+ * a declaration (the main block) or at a declaration it cannot delimit.
+ */
+std::vector<Parser::TokenSpan> Parser::scanFunctionSpans(size_t pos) const
+{
+    const std::vector<std::int8_t> &kinds = m_Tokens.kinds;
+    std::vector<TokenSpan> spans;
+    while (pos < kinds.size() && (kinds[pos] == tok_function || kinds[pos] == tok_procedure))
+    {
+        size_t begin = pos;
+        while (++pos < kinds.size() && kinds[pos] != tok_begin && kinds[pos] != tok_forward)
+        {
+            if (kinds[pos] == tok_function || kinds[pos] == tok_procedure)
+                return spans;
+        }
+        if (pos == kinds.size())
+            return spans;
+        if (kinds[pos] == tok_begin)
+        {
+            for (int depth = 0; pos < kinds.size(); ++pos)
+            {
+                if (kinds[pos] == tok_begin)
+                    ++depth;
+                else if (kinds[pos] == tok_end && --depth == 0)
+                    break;
+            }
+        }
+        pos += 2; // forward ; or end ;
+        if (pos >= kinds.size())
+            return spans;
+        spans.push_back({begin, pos});
+    }
+    return spans;
 }
 
-const llvm::Module &Parser::Generate()
+/**
+ * @brief Parses the function and procedure declarations in front of the main block
+ *
+ * Works on the spans found by scanFunctionSpans. Unless the parser is eager,
+ * declarations main cannot reach are skipped without being parsed. Big inputs
+ * are parsed on a thread pool. If any declaration fails to parse, or does not
+ * end exactly where the scan said it would, nothing is consumed and the caller
+ * parses the program serially, which reports errors exactly like before.
+ *
+ * @return true if the declarations were parsed and CurTok moved to the main block
+ */
+bool Parser::parseDeclarations(llvm::SmallVectorImpl<FunctionASTNode *> &functions)
 {
+    size_t declarationsBegin = m_Pos;
+    std::vector<TokenSpan> spans = scanFunctionSpans(m_Pos);
+    if (spans.empty())
+        return false;
+    size_t mainBegin = spans.back().end;
+    if (m_Tokens.kinds[mainBegin] == tok_function || m_Tokens.kinds[mainBegin] == tok_procedure)
+        return false; // the scan could not delimit every declaration
 
-    // create writeln function
+    size_t declared = spans.size();
+    if (m_Lazy && m_Tokens.kinds[mainBegin] != tok_eof) // without a main block there is no root to start from
+        spans = reachableSpans(spans, mainBegin);
+
+    std::vector<FunctionASTNode *> parsed(spans.size());
+    if (!spans.empty() && !parseFunctionsParallel(spans, parsed.data()) && !parseFunctionSpans(spans, parsed.data()))
     {
-        std::vector<llvm::Type *> Ints(1, llvm::Type::getInt32Ty(gen.MilaContext));
-        llvm::FunctionType *writelnFT = llvm::FunctionType::get(llvm::Type::getInt32Ty(gen.MilaContext), Ints, false);
-        llvm::Function *writelnF = llvm::Function::Create(writelnFT, llvm::Function::ExternalLinkage, "writeln", gen.MilaModule);
-        for (auto &Arg : writelnF->args())
-            Arg.setName("x");
+        m_Pos = declarationsBegin;
+        CurTok = m_Tokens.kinds[m_Pos];
+        return false;
     }
 
+    functions.append(parsed.begin(), parsed.end());
+    m_SkippedFunctions = declared - spans.size();
+    m_Pos = mainBegin;
+    CurTok = m_Tokens.kinds[m_Pos];
+    return true;
+}
+
+/**
+ * @brief Drops the declarations that cannot be called from the main block
+ *
+ * The call graph is built from tokens alone: a declaration references every
+ * function or procedure whose name appears as an identifier in it. That over-
+ * approximates calls (a variable sharing a function's name counts too), so
+ * nothing reachable is ever dropped. Forward declarations share the name of
+ * their definition and are kept or dropped with it.
+ */
+std::vector<Parser::TokenSpan> Parser::reachableSpans(llvm::ArrayRef<TokenSpan> spans, size_t mainBegin) const
+{
+    llvm::DenseMap<SymbolId, llvm::SmallVector<size_t, 2>> declarations;
+    for (size_t index = 0; index < spans.size(); ++index)
     {
-        std::vector<llvm::Type *> Ints(1, llvm::Type::getInt32PtrTy(gen.MilaContext));
-        llvm::FunctionType *readlnFT = llvm::FunctionType::get(llvm::Type::getInt32Ty(gen.MilaContext), Ints, false);
-        llvm::Function *readlnF = llvm::Function::Create(readlnFT, llvm::Function::ExternalLinkage, "readln", gen.MilaModule);
-        for (auto &Arg : readlnF->args())
-            Arg.setName("x");
+        size_t nameToken = spans[index].begin + 1;
+        if (m_Tokens.kinds[nameToken] != tok_identifier)
+            return spans.vec();
+        declarations[m_Tokens.payloads[nameToken]].push_back(index);
     }
 
-    astRoot->codegen(gen);
+    std::vector<char> reachable(spans.size(), false);
+    llvm::SmallVector<size_t, 64> worklist;
+    auto visitReferences = [&](size_t begin, size_t end) {
+        for (size_t pos = begin; pos < end; ++pos)
+        {
+            if (m_Tokens.kinds[pos] != tok_identifier)
+                continue;
+            auto found = declarations.find(m_Tokens.payloads[pos]);
+            if (found == declarations.end())
+                continue;
+            for (size_t index : found->second)
+            {
+                if (!reachable[index])
+                {
+                    reachable[index] = true;
+                    worklist.push_back(index);
+                }
+            }
+        }
+    };
+
+    visitReferences(mainBegin, m_Tokens.size());
+    while (!worklist.empty())
+    {
+        const TokenSpan &span = spans[worklist.pop_back_val()];
+        visitReferences(span.begin + 2, span.end);
+    }
 
-    return this->gen.MilaModule;
+    std::vector<TokenSpan> kept;
+    for (size_t index = 0; index < spans.size(); ++index)
+    {
+        if (reachable[index])
+            kept.push_back(spans[index]);
+    }
+    return kept;
+}
+
+/**
+ * @brief Parses declarations on a thread pool
+ *
+ * The spans are split into chunks, each parsed by a worker parser into its own
+ * arena. The results land in `functions` in the order of `spans`.
+ *
+ * @return false if the input is too small to be worth it or a chunk failed to parse
+ */
+bool Parser::parseFunctionsParallel(llvm::ArrayRef<TokenSpan> spans, FunctionASTNode **functions)
+{
+    llvm::ThreadPoolStrategy strategy = llvm::hardware_concurrency(m_Jobs);
+    if (strategy.compute_thread_count() < 2 || spans.size() < 2)
+        return false;
+    size_t totalTokens = 0;
+    for (const TokenSpan &span : spans)
+        totalTokens += span.end - span.begin;
+    if (totalTokens < parallelParseMinTokens)
+        return false;
+
+    // a few chunks per thread balance uneven function sizes
+    size_t chunkTokens = totalTokens / (strategy.compute_thread_count() * 4) + 1;
+    std::vector<size_t> chunkStarts;
+    for (size_t first = 0; first < spans.size();)
+    {
+        chunkStarts.push_back(first);
+        size_t tokens = spans[first].end - spans[first].begin;
+        size_t last = first + 1;
+        while (last < spans.size() && (tokens += spans[last].end - spans[last].begin) <= chunkTokens)
+            ++last;
+        first = last;
+    }
+    chunkStarts.push_back(spans.size());
+
+    std::vector<std::unique_ptr<Arena>> arenas(chunkStarts.size() - 1);
+    std::vector<char> succeeded(arenas.size(), false);
+    llvm::ThreadPool pool(strategy);
+    for (size_t chunk = 0; chunk < arenas.size(); ++chunk)
+    {
+        arenas[chunk] = std::make_unique<Arena>();
+        pool.async([this, chunk, spans, functions, &chunkStarts, &arenas, &succeeded]() {
+            size_t first = chunkStarts[chunk];
+            Parser worker(m_Tokens, *arenas[chunk]);
+            succeeded[chunk] = worker.parseFunctionSpans(spans.slice(first, chunkStarts[chunk + 1] - first), functions + first);
+        });
+    }
+    pool.wait();
+
+    if (std::find(succeeded.begin(), succeeded.end(), false) != succeeded.end())
+        return false;
+    std::move(arenas.begin(), arenas.end(), std::back_inserter(m_WorkerArenas));
+    return true;
+}
+
+// parses each declaration from its first token, checking it ends where the scan said it would
+bool Parser::parseFunctionSpans(llvm::ArrayRef<TokenSpan> spans, FunctionASTNode **functions)
+{
+    try
+    {
+        for (const TokenSpan &span : spans)
+        {
+            m_Pos = span.begin;
+            CurTok = m_Tokens.kinds[m_Pos];
+            *functions++ = parseFunction();
+            if (m_Pos != span.end)
+                return false;
+        }
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
+
+llvm::Module &Parser::Generate()
+{
+    gen = std::make_unique<GenContext>();
+    gen->declareRuntime();
+
+    astRoot->codegen(*gen);
+
+    return gen->MilaModule;
+}
+
+std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>> Parser::takeModule()
+{
+    std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>> result(std::move(gen->ContextOwner),
+                                                                                        std::move(gen->ModuleOwner));
+    // the builder and value handles refer into the context, drop them while it still exists
+    gen.reset();
+    return result;
 }
 
 /**
  * @brief Simple token buffer.
  *
  * CurTok is the current token the parser is looking at
- * getNextToken reads another token from the lexer and updates curTok with ts result
+ * getNextToken moves to the next token of the pre-lexed buffer and updates curTok with its kind,
+ * the buffer ends with tok_eof which is never stepped over
  * Every function in the parser will assume that CurTok is the cureent token that needs to be parsed
  */
 int Parser::getNextToken()
 {
-    CurTok = m_Lexer.gettok();
-    // if(CurTok == tok_identifier) std::cout << CurTok << " - " << m_Lexer.identifierStr() << " " << std::endl;
-    // else std::cout << CurTok << " - " << tokenMap[CurTok] << " " << std::endl;
+    if (m_Pos + 1 < m_Tokens.size())
+        ++m_Pos;
+    CurTok = m_Tokens.kinds[m_Pos];
+    // if(CurTok == tok_identifier) std::cout << CurTok << " - " << SymbolPool::global().name(curIdentifier()).str() << " " << std::endl;
+    // else std::cout << CurTok << " - " << tokenName(CurTok) << " " << std::endl;
     return CurTok;
 }
 
+int Parser::peekToken(size_t ahead) const
+{
+    size_t pos = std::min(m_Pos + ahead, m_Tokens.size() - 1);
+    return m_Tokens.kinds[pos];
+}
+
+void Parser::error(const std::string &message) const
+{
+    throw std::logic_error(std::to_string(m_Tokens.lines[m_Pos]) + ":" + std::to_string(m_Tokens.columns[m_Pos]) + ": " + message);
+}
+
+void Parser::printStatistics(std::ostream &os) const
+{
+    size_t count = m_Tokens.size();
+    os << "tokens: " << count << ", " << TokenBuffer::bytesPerToken << " bytes/token, "
+       << count * TokenBuffer::bytesPerToken << " bytes used, " << m_Tokens.memoryUsage() << " bytes allocated" << std::endl;
+    size_t nodes = m_Arena.nodeCount(), bytes = m_Arena.bytesAllocated(), slabs = m_Arena.slabCount();
+    for (const std::unique_ptr<Arena> &arena : m_WorkerArenas)
+    {
+        nodes += arena->nodeCount();
+        bytes += arena->bytesAllocated();
+        slabs += arena->slabCount();
+    }
+    os << "AST nodes: " << nodes << ", arena: " << bytes << " bytes in " << slabs << " slabs";
+    if (!m_WorkerArenas.empty())
+        os << " (" << m_WorkerArenas.size() + 1 << " arenas)";
+    os << std::endl;
+    if (m_SkippedFunctions)
+        os << "declarations skipped as unreachable: " << m_SkippedFunctions << std::endl;
+}
+
 // program -> function program | procedure program | mainfunction
 // function -> prototype variableDeclarBlock ConstDeclarBlock  function_block
 // VariableDeclarBlock - > variableDeclare VariableDeclareBlock | E
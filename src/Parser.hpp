@@ -16,119 +16,126 @@
 
 #include "Lexer.hpp"
 #include "ast.hpp"
-#include <map>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
 
-static std::map<int, std::string> tokenMap = {
-    {':', ":"},
-    {'*', "*"},
-    {')', ")"},
-    {'(', "("},
-    {';', ";"},
-    {61, "equal_token"},
-    {-1, "tok_eof"},
-    {-2, "tok_identifier"},
-    {-3, "tok_number"},
-    {-4, "tok_begin"},
-    {-5, "tok_end"},
-    {-6, "tok_const"},
-    {-7, "tok_procedure"},
-    {-8, "tok_forward"},
-    {-9, "tok_function"},
-    {-10, "tok_if"},
-    {-11, "tok_then"},
-    {-12, "tok_else"},
-    {-13, "tok_program"},
-    {-14, "tok_while"},
-    {-15, "tok_exit"},
-    {-16, "tok_var"},
-    {-17, "tok_integer"},
-    {-18, "tok_for"},
-    {-19, "tok_do"},
-    {-20, "tok_notequal"},
-    {-21, "tok_lessequal"},
-    {-22, "tok_greaterequal"},
-    {-23, "tok_assign"},
-    {-24, "tok_or"},
-    {-25, "tok_mod"},
-    {-26, "tok_div"},
-    {-27, "tok_not"},
-    {-28, "tok_and"},
-    {-29, "tok_xor"},
-    {-30, "tok_to"},
-    {-31, "tok_downto"},
-    {-32, "tok_array"},
-    {-33, "tok_readln"}};
-
-static std::map<int, int> BinopPrecedence =
-    {
-        {tok_assign , 10},
-        {tok_or, 20},
-        {tok_and, 30},
-        {'=', 40},
-        {tok_notequal, 40},
-        {'<', 50},
-        {'>', 50},
-        {tok_greaterequal, 50},
-        {tok_lessequal, 50},
-        {'+', 60},
-        {'-', 60},
-        {'*', 70},
-        {tok_div, 70},
-        {tok_mod, 70},
-};
+constexpr std::array<std::int8_t, tokenCount> buildBinopPrecedence()
+{
+    std::array<std::int8_t, tokenCount> precedence{};
+    precedence[tokenIndex(tok_assign)] = 10;
+    precedence[tokenIndex(tok_or)] = 20;
+    precedence[tokenIndex(tok_and)] = 30;
+    precedence[tokenIndex('=')] = 40;
+    precedence[tokenIndex(tok_notequal)] = 40;
+    precedence[tokenIndex('<')] = 50;
+    precedence[tokenIndex('>')] = 50;
+    precedence[tokenIndex(tok_greaterequal)] = 50;
+    precedence[tokenIndex(tok_lessequal)] = 50;
+    precedence[tokenIndex('+')] = 60;
+    precedence[tokenIndex('-')] = 60;
+    precedence[tokenIndex('*')] = 70;
+    precedence[tokenIndex(tok_div)] = 70;
+    precedence[tokenIndex(tok_mod)] = 70;
+    return precedence;
+}
+
+// binding strength of every binary operator, 0 for tokens that are not one
+inline constexpr std::array<std::int8_t, tokenCount> BinopPrecedence = buildBinopPrecedence();
 
 class Parser
 {
 public:
-    Parser();
+    Parser(const std::string &fileName = "-");
     ~Parser() = default;
 
-    bool Parse();                   // parse
-    const llvm::Module &Generate(); // generate
+    // parse, function bodies on up to `jobs` threads (0 = all hardware threads),
+    // skipping the functions main cannot reach when `lazy`
+    bool Parse(unsigned jobs = 1, bool lazy = false);
+    llvm::Module &Generate();       // generate
+    const ProgramASTNode *getProgram() const { return astRoot; } // after a successful Parse
+    // hands the generated module over together with its context, e.g. to the JIT; ends code generation
+    std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>> takeModule();
+    void printStatistics(std::ostream &os) const;
 
 private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    // below this many tokens of function bodies the thread pool costs more than it saves
+    static constexpr size_t parallelParseMinTokens = 1 << 14;
+
+    // tokens [begin, end) of one top-level function or procedure declaration
+    struct TokenSpan
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    // parser for a slice of another parser's tokens, used by the parallel body parsing
+    Parser(const TokenBuffer &tokens, Arena &arena);
+
+    std::vector<TokenSpan> scanFunctionSpans(size_t pos) const;
+    std::vector<TokenSpan> reachableSpans(llvm::ArrayRef<TokenSpan> spans, size_t mainBegin) const;
+    bool parseDeclarations(llvm::SmallVectorImpl<FunctionASTNode *> &functions);
+    bool parseFunctionsParallel(llvm::ArrayRef<TokenSpan> spans, FunctionASTNode **functions);
+    bool parseFunctionSpans(llvm::ArrayRef<TokenSpan> spans, FunctionASTNode **functions);
+
     int getNextToken();
+    int peekToken(size_t ahead = 1) const; // kind of the token `ahead` positions after CurTok
+    SymbolId curIdentifier() const { return m_Tokens.payloads[m_Pos]; }
+    int curNumber() const { return static_cast<int>(m_Tokens.payloads[m_Pos]); }
+    [[noreturn]] void error(const std::string &message) const;
     void handleConstantDeclaration();
 
-    std::string parseFunctionParameter();
-    void parseConstantDeclarationBlock(std::vector<std::unique_ptr<ConstantDeclarationASTNode>> &);
-    void parseVariableDeclarationBLock(std::vector<std::unique_ptr<VariableDeclarationASTNode>> &);
-    std::unique_ptr<FunctionASTNode> parseMainFunction();
-
-    std::unique_ptr<FunctionASTNode> parseFunction();
-    std::unique_ptr<PrototypeASTNode> parseProtoType();
-    std::unique_ptr<VariableDeclarationASTNode> parseReturnValue();
-    std::unique_ptr<ExprASTNode> parseIfElseExpression();
-    std::unique_ptr<BreakASTNode> parseBreak();
-
-    std::unique_ptr<ConstantDeclarationASTNode> parseConstantDeclaration();
-    void parseVariableDeclaration(std::vector<std::unique_ptr<VariableDeclarationASTNode>> &statements);
-    std::unique_ptr<VariableASTNode> parseVariable();
-    std::unique_ptr<NumberASTNode> parseNumber();
-    std::unique_ptr<ProgramASTNode> parseProgram();
-    std::unique_ptr<BlockStatmentASTNode> parseBlockStatement();
-    std::unique_ptr<BlockStatmentASTNode> parseMainFunctionBlock();
-    std::unique_ptr<ExprASTNode> parseReadLnExpression();
-    std::unique_ptr<UnaryOperationASTNode> parseUnaryExpression();
-    std::unique_ptr<ExprASTNode> parseAssignemntExpression(const std::string identifier);
-    std::unique_ptr<ExprASTNode> parseIdentiferExpression();
-    std::unique_ptr<ExprASTNode> parseExpression();
-    std::unique_ptr<ExprASTNode> parsePrimary();
-    std::unique_ptr<ExprASTNode> parseNumberExpression();
-    std::unique_ptr<ExprASTNode> parseParentheseExpression();
-    std::unique_ptr<ForASTNode> parseForExpression();
+    SymbolId parseFunctionParameter();
+    void parseConstantDeclarationBlock(llvm::SmallVectorImpl<ConstantDeclarationASTNode *> &);
+    void parseVariableDeclarationBLock(llvm::SmallVectorImpl<VariableDeclarationASTNode *> &);
+    FunctionASTNode *parseMainFunction();
+
+    FunctionASTNode *parseFunction();
+    PrototypeASTNode *parseProtoType();
+    VariableDeclarationASTNode *parseReturnValue(SymbolId);
+    ExprASTNode *parseIfElseExpression();
+    BreakASTNode *parseBreak();
+
+    ConstantDeclarationASTNode *parseConstantDeclaration();
+    void parseVariableDeclaration(llvm::SmallVectorImpl<VariableDeclarationASTNode *> &statements);
+    VariableASTNode *parseVariable();
+    NumberASTNode *parseNumber();
+    ProgramASTNode *parseProgram();
+    BlockStatmentASTNode *parseBlockStatement();
+    BlockStatmentASTNode *parseMainFunctionBlock();
+    ExprASTNode *parseReadLnExpression();
+    UnaryOperationASTNode *parseUnaryExpression();
+    ExprASTNode *parseAssignemntExpression(SymbolId identifier);
+    ExprASTNode *parseIdentiferExpression();
+    ExprASTNode *parseExpression();
+    ExprASTNode *parsePrimary();
+    ExprASTNode *parseNumberExpression();
+    ExprASTNode *parseParentheseExpression();
+    ForASTNode *parseForExpression();
     int GetTokPrecedence();
-    std::unique_ptr<ExprASTNode> ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprASTNode> LHS);
-    std::unique_ptr<ExprASTNode> parseExpressionLines();
-    std::unique_ptr<FunctionExitASTNode> parseFunctionExit();
-    std::unique_ptr<WhileASTNode> parseWhile();
+    ExprASTNode *ParseBinOpRHS(ExprASTNode *LHS);
+    ExprASTNode *parseExpressionLines();
+    FunctionExitASTNode *parseFunctionExit();
+    WhileASTNode *parseWhile();
 
-    Lexer m_Lexer; // lexer is used to read tokens
-    int CurTok;    // to keep the current token
-    std::unique_ptr<ProgramASTNode> astRoot;
+    std::optional<Lexer> m_Lexer; // lexer is used to read tokens, empty in worker parsers
+    TokenBuffer m_OwnTokens;      // whole token stream, lexed once by Parse
+    const TokenBuffer &m_Tokens;  // m_OwnTokens, or the main parser's tokens in a worker
+    Arena m_OwnArena;
+    Arena &m_Arena;               // owns every AST node, freed in one go with the parser
+    std::vector<std::unique_ptr<Arena>> m_WorkerArenas; // nodes of the function bodies parsed in parallel
+    unsigned m_Jobs = 1;
+    bool m_Lazy = false;
+    size_t m_SkippedFunctions = 0;
+    size_t m_Pos = npos;          // index of CurTok in m_Tokens
+    int CurTok;                   // to keep the current token
+    ProgramASTNode *astRoot = nullptr;
 
-    GenContext gen;
+    std::unique_ptr<GenContext> gen; // created by Generate
 };
 
 #endif // PJPPROJECT_PARSER_HPP
@@ -0,0 +1,114 @@
+#include "SSABuilder.hpp"
+
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Constants.h>
+
+void SSABuilder::reset()
+{
+    m_CurrentDef.clear();
+    m_IncompletePhis.clear();
+    m_Sealed.clear();
+}
+
+void SSABuilder::writeVariable(SymbolId variable, llvm::BasicBlock *block, llvm::Value *value)
+{
+    m_CurrentDef[{block, variable}] = value;
+}
+
+llvm::Value *SSABuilder::readVariable(SymbolId variable, llvm::Type *type, llvm::BasicBlock *block)
+{
+    auto found = m_CurrentDef.find({block, variable});
+    if (found != m_CurrentDef.end() && found->second)
+        return found->second;
+    return readVariableRecursive(variable, type, block);
+}
+
+llvm::Value *SSABuilder::readVariableRecursive(SymbolId variable, llvm::Type *type, llvm::BasicBlock *block)
+{
+    llvm::Value *value = nullptr;
+    if (!m_Sealed.count(block))
+    {
+        // predecessors still missing, complete the phi when the block gets sealed
+        llvm::PHINode *phi = createPhi(variable, type, block);
+        m_IncompletePhis[block].emplace_back(variable, phi);
+        value = phi;
+    }
+    else if (llvm::BasicBlock *predecessor = block->getUniquePredecessor())
+    {
+        value = readVariable(variable, type, predecessor);
+    }
+    else if (llvm::pred_empty(block))
+    {
+        // unreachable code, or a read before any assignment
+        value = llvm::UndefValue::get(type);
+    }
+    else
+    {
+        // record the phi first, so that reads coming back around a loop end at it
+        llvm::PHINode *phi = createPhi(variable, type, block);
+        writeVariable(variable, block, phi);
+        addPhiOperands(variable, phi);
+        return m_CurrentDef[{block, variable}];
+    }
+    writeVariable(variable, block, value);
+    return value;
+}
+
+llvm::PHINode *SSABuilder::createPhi(SymbolId variable, llvm::Type *type, llvm::BasicBlock *block)
+{
+    llvm::StringRef name = SymbolPool::global().name(variable);
+    if (block->empty())
+        return llvm::PHINode::Create(type, 2, name, block);
+    return llvm::PHINode::Create(type, 2, name, &block->front());
+}
+
+void SSABuilder::addPhiOperands(SymbolId variable, llvm::PHINode *phi)
+{
+    for (llvm::BasicBlock *predecessor : llvm::predecessors(phi->getParent()))
+        phi->addIncoming(readVariable(variable, phi->getType(), predecessor), predecessor);
+    tryRemoveTrivialPhi(phi);
+}
+
+void SSABuilder::tryRemoveTrivialPhi(llvm::PHINode *phi)
+{
+    llvm::Value *same = nullptr;
+    for (llvm::Value *operand : phi->incoming_values())
+    {
+        if (operand == same || operand == phi)
+            continue;
+        if (same)
+            return; // merges at least two values
+        same = operand;
+    }
+    if (!same)
+        same = llvm::UndefValue::get(phi->getType());
+
+    // phis using this one may become trivial once it is gone
+    llvm::SmallVector<llvm::WeakTrackingVH, 8> users;
+    for (llvm::User *user : phi->users())
+    {
+        if (user != phi && llvm::isa<llvm::PHINode>(user))
+            users.emplace_back(user);
+    }
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+
+    for (llvm::WeakTrackingVH &user : users)
+    {
+        if (auto *userPhi = llvm::dyn_cast_or_null<llvm::PHINode>(static_cast<llvm::Value *>(user)))
+            tryRemoveTrivialPhi(userPhi);
+    }
+}
+
+void SSABuilder::sealBlock(llvm::BasicBlock *block)
+{
+    // sealed before completing, reads made while completing must not add new incomplete phis here
+    m_Sealed.insert(block);
+    auto found = m_IncompletePhis.find(block);
+    if (found == m_IncompletePhis.end())
+        return;
+    llvm::SmallVector<std::pair<SymbolId, llvm::PHINode *>, 4> phis = std::move(found->second);
+    m_IncompletePhis.erase(found);
+    for (auto &[variable, phi] : phis)
+        addPhiOperands(variable, phi);
+}
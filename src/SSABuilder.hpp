@@ -0,0 +1,48 @@
+#ifndef PJPPROJECT_SSABUILDER_HPP
+#define PJPPROJECT_SSABUILDER_HPP
+
+#include <utility>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/ValueHandle.h>
+
+#include "SymbolPool.hpp"
+
+/*
+ * On-the-fly SSA construction for local scalars, after Braun et al.,
+ * "Simple and Efficient Construction of Static Single Assignment Form" (CC 2013).
+ *
+ * An assignment records the variable's value for the current block. A read
+ * looks the value up, walking back through predecessors and placing a phi
+ * where control flow merges. A block has to be sealed once all of its
+ * predecessors are known; reads in a block that is not sealed yet (a loop
+ * header before its back edge exists) get an operand-less phi that is
+ * completed when the block is sealed. Phis merging a single value are
+ * removed as soon as that is known.
+ */
+class SSABuilder
+{
+public:
+    void reset(); // forget all values and blocks, before lowering another function
+
+    void writeVariable(SymbolId variable, llvm::BasicBlock *block, llvm::Value *value);
+    llvm::Value *readVariable(SymbolId variable, llvm::Type *type, llvm::BasicBlock *block);
+    void sealBlock(llvm::BasicBlock *block);
+
+private:
+    llvm::Value *readVariableRecursive(SymbolId variable, llvm::Type *type, llvm::BasicBlock *block);
+    llvm::PHINode *createPhi(SymbolId variable, llvm::Type *type, llvm::BasicBlock *block);
+    void addPhiOperands(SymbolId variable, llvm::PHINode *phi);
+    void tryRemoveTrivialPhi(llvm::PHINode *phi);
+
+    // value handles follow a removed phi to the value replacing it
+    llvm::DenseMap<std::pair<llvm::BasicBlock *, SymbolId>, llvm::WeakTrackingVH> m_CurrentDef;
+    llvm::DenseMap<llvm::BasicBlock *, llvm::SmallVector<std::pair<SymbolId, llvm::PHINode *>, 4>> m_IncompletePhis;
+    llvm::SmallPtrSet<llvm::BasicBlock *, 32> m_Sealed;
+};
+
+#endif // PJPPROJECT_SSABUILDER_HPP
@@ -0,0 +1,22 @@
+#include "SymbolPool.hpp"
+
+SymbolPool::SymbolPool()
+{
+    // same order as SymbolPool::Builtin
+    for (const char *name : {"main", "writeln", "write", "readln", "inc", "dec"})
+        intern(name);
+}
+
+SymbolPool &SymbolPool::global()
+{
+    static SymbolPool pool;
+    return pool;
+}
+
+SymbolId SymbolPool::intern(std::string_view name)
+{
+    auto inserted = m_Ids.try_emplace(llvm::StringRef(name.data(), name.size()), SymbolId(m_Names.size()));
+    if (inserted.second)
+        m_Names.push_back(inserted.first->getKey());
+    return inserted.first->getValue();
+}
@@ -0,0 +1,49 @@
+#ifndef PJPPROJECT_SYMBOLPOOL_HPP
+#define PJPPROJECT_SYMBOLPOOL_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
+
+using SymbolId = std::uint32_t;
+
+/*
+ * Interning table for identifiers. Every distinct name is stored once and
+ * referred to by a 32-bit id, so the parser and code generator compare and
+ * hash integers instead of strings.
+ *
+ * Names are only added while lexing; afterwards the pool is read-only and
+ * may be shared between threads.
+ */
+class SymbolPool
+{
+public:
+    // names the compiler refers to itself, interned up front with fixed ids
+    enum Builtin : SymbolId
+    {
+        sym_main,
+        sym_writeln,
+        sym_write,
+        sym_readln,
+        sym_inc,
+        sym_dec
+    };
+
+    static SymbolPool &global();
+
+    SymbolId intern(std::string_view name);
+    llvm::StringRef name(SymbolId id) const { return m_Names[id]; }
+    size_t size() const { return m_Names.size(); }
+
+private:
+    SymbolPool();
+
+    llvm::StringMap<SymbolId, llvm::BumpPtrAllocator> m_Ids;
+    std::vector<llvm::StringRef> m_Names; // indexed by id, points to keys of m_Ids
+};
+
+#endif // PJPPROJECT_SYMBOLPOOL_HPP
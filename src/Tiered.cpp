@@ -0,0 +1,155 @@
+#include "Tiered.hpp"
+#include "Interpreter.hpp"
+#include "Jit.hpp"
+#include "Optimizer.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/Support/ThreadPool.h>
+
+using CallGraph = llvm::DenseMap<SymbolId, llvm::SmallVector<SymbolId, 4>>;
+
+// appends the callee of every call below node
+static void collectCalls(const ASTNode *node, llvm::SmallVectorImpl<SymbolId> &calls)
+{
+    if (!node)
+        return;
+    switch (node->getKind())
+    {
+    case ASTNode::Kind::Assignment:
+        collectCalls(llvm::cast<AssignmentASTNode>(node)->getExpr(), calls);
+        return;
+    case ASTNode::Kind::UnaryOperation:
+        collectCalls(llvm::cast<UnaryOperationASTNode>(node)->getExpr(), calls);
+        return;
+    case ASTNode::Kind::BinaryOperation:
+        collectCalls(llvm::cast<BinaryOperationASTNode>(node)->getLHS(), calls);
+        collectCalls(llvm::cast<BinaryOperationASTNode>(node)->getRHS(), calls);
+        return;
+    case ASTNode::Kind::FunctionCall:
+        calls.push_back(llvm::cast<FunctionCallExprASTNode>(node)->getCallee());
+        for (const ExprASTNode *arg : llvm::cast<FunctionCallExprASTNode>(node)->getArgs())
+            collectCalls(arg, calls);
+        return;
+    case ASTNode::Kind::For:
+        collectCalls(llvm::cast<ForASTNode>(node)->getAssign(), calls);
+        collectCalls(llvm::cast<ForASTNode>(node)->getBound(), calls);
+        collectCalls(llvm::cast<ForASTNode>(node)->getBody(), calls);
+        return;
+    case ASTNode::Kind::While:
+        collectCalls(llvm::cast<WhileASTNode>(node)->getCondition(), calls);
+        collectCalls(llvm::cast<WhileASTNode>(node)->getBody(), calls);
+        return;
+    case ASTNode::Kind::IfElse:
+        collectCalls(llvm::cast<IfElseASTNode>(node)->getCondition(), calls);
+        collectCalls(llvm::cast<IfElseASTNode>(node)->getThen(), calls);
+        collectCalls(llvm::cast<IfElseASTNode>(node)->getElse(), calls);
+        return;
+    case ASTNode::Kind::VariableDeclaration:
+        collectCalls(llvm::cast<VariableDeclarationASTNode>(node)->getValue(), calls);
+        return;
+    case ASTNode::Kind::BlockStatement:
+        for (const ExprASTNode *expression : llvm::cast<BlockStatmentASTNode>(node)->getExpressions())
+            collectCalls(expression, calls);
+        return;
+    case ASTNode::Kind::MainFunctionBlockStatement:
+        for (const ExprASTNode *expression : llvm::cast<MainFunctionBlockStatementASTNode>(node)->getExpressions())
+            collectCalls(expression, calls);
+        return;
+    case ASTNode::Kind::Function:
+    {
+        const auto *function = llvm::cast<FunctionASTNode>(node);
+        for (const VariableDeclarationASTNode *variable : function->getVariables())
+            collectCalls(variable, calls);
+        collectCalls(function->getBody(), calls);
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+/*
+ * Module with `name` under the external symbol `symbol` and internal copies
+ * of everything it calls, optimized at -O2 for the JIT's target. Compiled in
+ * its own module, a hot function never clashes with the copies in others.
+ */
+static void *compileHot(llvm::orc::LLJIT &jit, const ProgramASTNode &program, const CallGraph &calls, SymbolId name,
+                        const std::string &symbol)
+{
+    llvm::DenseSet<SymbolId> reached{name};
+    llvm::SmallVector<SymbolId, 8> worklist{name};
+    while (!worklist.empty())
+    {
+        auto it = calls.find(worklist.pop_back_val());
+        if (it == calls.end())
+            continue;
+        for (SymbolId callee : it->second)
+            if (reached.insert(callee).second)
+                worklist.push_back(callee);
+    }
+
+    auto gen = std::make_unique<GenContext>();
+    gen->declareRuntime();
+    // program order: callees and forward declarations come before their calls, as in Parser::Generate
+    for (const FunctionASTNode *function : program.getFunctions())
+        if (reached.count(function->getPrototype()->getName()))
+            function->codegen(*gen);
+
+    // the interpreter calls the hot function with the C convention (callNative)
+    llvm::Function *hot = gen->functionTable.lookup(name);
+    internalizeFunctions(gen->MilaModule, hot);
+    hot->setName(symbol);
+    gen->MilaModule.setTargetTriple(jit.getTargetTriple().str());
+    gen->MilaModule.setDataLayout(jit.getDataLayout());
+    optimizeModule(gen->MilaModule, 2);
+
+    std::unique_ptr<llvm::LLVMContext> context = std::move(gen->ContextOwner);
+    std::unique_ptr<llvm::Module> module = std::move(gen->ModuleOwner);
+    gen.reset(); // refers into the context
+    return jitCompile(jit, std::move(context), std::move(module), symbol);
+}
+
+int runTiered(const ProgramASTNode &program, unsigned threshold, bool verbose)
+{
+    Interpreter interpreter(program);
+
+    CallGraph calls;
+    for (const FunctionASTNode *function : program.getFunctions())
+        collectCalls(function, calls[function->getPrototype()->getName()]);
+
+    // declared before the pool: destroying the pool waits for running compilations, which use the JIT
+    std::unique_ptr<llvm::orc::LLJIT> jit; // created by the first compilation, short runs never pay for it
+    llvm::ThreadPool compiler(llvm::hardware_concurrency(1));
+
+    interpreter.enableTiering(threshold, [&](std::uint32_t function) {
+        if (interpreter.functionParams(function) > Interpreter::maxNativeArity)
+            return;
+        compiler.async([&, function] {
+            std::string name = SymbolPool::global().name(interpreter.functionName(function)).str();
+            std::ostringstream report;
+            try
+            {
+                auto start = std::chrono::steady_clock::now();
+                if (!jit)
+                    jit = createJit(2);
+                std::string symbol = "mila.tier." + std::to_string(function);
+                interpreter.setNative(function, compileHot(*jit, program, calls, interpreter.functionName(function), symbol));
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+                report << "tiered: " << name << " compiled in " << elapsed.count() / 1000.0 << " ms\n";
+            }
+            catch (const std::exception &e)
+            {
+                // the function just stays in the interpreter
+                report << "tiered: " << name << " not compiled: " << e.what() << "\n";
+            }
+            if (verbose)
+                std::cerr << report.str();
+        });
+    });
+
+    return interpreter.run();
+}
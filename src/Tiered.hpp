@@ -0,0 +1,17 @@
+#ifndef PJPPROJECT_TIERED_HPP
+#define PJPPROJECT_TIERED_HPP
+
+#include "ast.hpp"
+
+/*
+ * Runs `program` in the bytecode interpreter and moves hot functions to
+ * native code. A function called or looping `threshold` times is compiled at
+ * -O2, together with private copies of the functions it calls, on a
+ * background thread; its calls go to the native code from then on. main
+ * itself always stays interpreted, there is no switch in the middle of a
+ * running call. With `verbose` every compiled function is reported on
+ * stderr. Returns main's result.
+ */
+int runTiered(const ProgramASTNode &program, unsigned threshold, bool verbose = false);
+
+#endif // PJPPROJECT_TIERED_HPP
@@ -1,6 +1,103 @@
 #include "ast.hpp"
 
-GenContext::GenContext() : MilaContext(), MilaBuilder(MilaContext), MilaModule("mila", MilaContext) {}
+GenContext::GenContext()
+    : ContextOwner(std::make_unique<llvm::LLVMContext>()), ModuleOwner(std::make_unique<llvm::Module>("mila", *ContextOwner)),
+      MilaContext(*ContextOwner), MilaBuilder(MilaContext), MilaModule(*ModuleOwner)
+{
+}
+
+void GenContext::declareRuntime()
+{
+    // create writeln function
+    {
+        std::vector<llvm::Type *> Ints(1, llvm::Type::getInt32Ty(MilaContext));
+        llvm::FunctionType *writelnFT = llvm::FunctionType::get(llvm::Type::getInt32Ty(MilaContext), Ints, false);
+        llvm::Function *writelnF = llvm::Function::Create(writelnFT, llvm::Function::ExternalLinkage, "writeln", MilaModule);
+        for (auto &Arg : writelnF->args())
+            Arg.setName("x");
+        functionTable[SymbolPool::sym_writeln] = writelnF;
+    }
+
+    // value read and status packed into an i64, see fce.c
+    {
+        llvm::FunctionType *readlnFT = llvm::FunctionType::get(llvm::Type::getInt64Ty(MilaContext), false);
+        llvm::Function *readlnF = llvm::Function::Create(readlnFT, llvm::Function::ExternalLinkage, "readln", MilaModule);
+        functionTable[SymbolPool::sym_readln] = readlnF;
+    }
+}
+
+void GenContext::startUnreachableBlock(const char *name)
+{
+    llvm::Function *function = MilaBuilder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *block = llvm::BasicBlock::Create(MilaContext, name, function);
+    ssa.sealBlock(block);
+    MilaBuilder.SetInsertPoint(block);
+}
+
+llvm::Instruction *GenContext::branchTo(llvm::BasicBlock *target)
+{
+    llvm::BasicBlock *block = MilaBuilder.GetInsertBlock();
+    if (block != &block->getParent()->getEntryBlock() && llvm::pred_empty(block))
+        return MilaBuilder.CreateUnreachable();
+    return MilaBuilder.CreateBr(target);
+}
+
+bool GenContext::branchOn(const ExprASTNode *condition, llvm::BasicBlock *ifTrue, llvm::BasicBlock *ifFalse, const char *name)
+{
+    const auto *binary = llvm::dyn_cast<BinaryOperationASTNode>(condition);
+    if (binary && (binary->getOperator() == tok_and || binary->getOperator() == tok_or) && binary->isCondition())
+    {
+        bool isAnd = binary->getOperator() == tok_and;
+        llvm::Function *function = MilaBuilder.GetInsertBlock()->getParent();
+        // added to the function only once the left operand has branched to it
+        llvm::BasicBlock *right = llvm::BasicBlock::Create(MilaContext, isAnd ? "and" : "or");
+        if (!branchOn(binary->getLHS(), isAnd ? right : ifTrue, isAnd ? ifFalse : right, name))
+        {
+            if (right->use_empty())
+                delete right;
+            else // a nested operand branched here before another one failed
+            {
+                right->insertInto(function);
+                new llvm::UnreachableInst(MilaContext, right);
+            }
+            return false;
+        }
+        right->insertInto(function);
+        sealBlock(right);
+        MilaBuilder.SetInsertPoint(right);
+        return branchOn(binary->getRHS(), ifTrue, ifFalse, name);
+    }
+    llvm::Value *value = condition->codegen(*this);
+    if (!value)
+        return false;
+    // comparisons are i1 already, integers are true when nonzero
+    if (!value->getType()->isIntegerTy(1))
+        value = MilaBuilder.CreateICmpNE(value, llvm::Constant::getNullValue(value->getType()), name);
+    MilaBuilder.CreateCondBr(value, ifTrue, ifFalse);
+    return true;
+}
+
+void GenContext::declareVariable(SymbolId name, llvm::Value *initial)
+{
+    if (!symbolTable.insert(name).second)
+        throw std::logic_error("Variable already declared");
+    if (initial)
+        ssa.writeVariable(name, MilaBuilder.GetInsertBlock(), initial);
+}
+
+llvm::Value *GenContext::readVariable(SymbolId name)
+{
+    if (!symbolTable.count(name))
+        throw std::logic_error("variable not defined");
+    return ssa.readVariable(name, llvm::Type::getInt32Ty(MilaContext), MilaBuilder.GetInsertBlock());
+}
+
+void GenContext::writeVariable(SymbolId name, llvm::Value *value)
+{
+    if (!symbolTable.count(name))
+        throw std::logic_error("var not declared");
+    ssa.writeVariable(name, MilaBuilder.GetInsertBlock(), value);
+}
 
 void ASTNode::printIndent(int level) const
 {
@@ -13,6 +110,126 @@ void ASTNode::printIndent(int level) const
     }
 }
 
+void ASTNode::print(int level) const
+{
+    switch (m_kind)
+    {
+    case Kind::Variable:
+        static_cast<const VariableASTNode *>(this)->print(level);
+        return;
+    case Kind::Assignment:
+        static_cast<const AssignmentASTNode *>(this)->print(level);
+        return;
+    case Kind::Number:
+        static_cast<const NumberASTNode *>(this)->print(level);
+        return;
+    case Kind::UnaryOperation:
+        static_cast<const UnaryOperationASTNode *>(this)->print(level);
+        return;
+    case Kind::BinaryOperation:
+        static_cast<const BinaryOperationASTNode *>(this)->print(level);
+        return;
+    case Kind::Increment:
+        static_cast<const IncrementExprASTNode *>(this)->print(level);
+        return;
+    case Kind::Decrement:
+        static_cast<const DecrementExprASTNode *>(this)->print(level);
+        return;
+    case Kind::Readln:
+        static_cast<const ReadlnExprASTNode *>(this)->print(level);
+        return;
+    case Kind::FunctionCall:
+        static_cast<const FunctionCallExprASTNode *>(this)->print(level);
+        return;
+    case Kind::For:
+        static_cast<const ForASTNode *>(this)->print(level);
+        return;
+    case Kind::While:
+        static_cast<const WhileASTNode *>(this)->print(level);
+        return;
+    case Kind::IfElse:
+        static_cast<const IfElseASTNode *>(this)->print(level);
+        return;
+    case Kind::Break:
+        static_cast<const BreakASTNode *>(this)->print(level);
+        return;
+    case Kind::FunctionExit:
+        static_cast<const FunctionExitASTNode *>(this)->print(level);
+        return;
+    case Kind::ConstantDeclaration:
+        static_cast<const ConstantDeclarationASTNode *>(this)->print(level);
+        return;
+    case Kind::VariableDeclaration:
+        static_cast<const VariableDeclarationASTNode *>(this)->print(level);
+        return;
+    case Kind::BlockStatement:
+        static_cast<const BlockStatmentASTNode *>(this)->print(level);
+        return;
+    case Kind::MainFunctionBlockStatement:
+        static_cast<const MainFunctionBlockStatementASTNode *>(this)->print(level);
+        return;
+    case Kind::Prototype:
+        static_cast<const PrototypeASTNode *>(this)->print(level);
+        return;
+    case Kind::Function:
+        static_cast<const FunctionASTNode *>(this)->print(level);
+        return;
+    case Kind::Program:
+        static_cast<const ProgramASTNode *>(this)->print(level);
+        return;
+    }
+}
+
+llvm::Value *ASTNode::codegen(GenContext &gen) const
+{
+    switch (m_kind)
+    {
+    case Kind::Variable:
+        return static_cast<const VariableASTNode *>(this)->codegen(gen);
+    case Kind::Assignment:
+        return static_cast<const AssignmentASTNode *>(this)->codegen(gen);
+    case Kind::Number:
+        return static_cast<const NumberASTNode *>(this)->codegen(gen);
+    case Kind::UnaryOperation:
+        return static_cast<const UnaryOperationASTNode *>(this)->codegen(gen);
+    case Kind::BinaryOperation:
+        return static_cast<const BinaryOperationASTNode *>(this)->codegen(gen);
+    case Kind::Increment:
+        return static_cast<const IncrementExprASTNode *>(this)->codegen(gen);
+    case Kind::Decrement:
+        return static_cast<const DecrementExprASTNode *>(this)->codegen(gen);
+    case Kind::Readln:
+        return static_cast<const ReadlnExprASTNode *>(this)->codegen(gen);
+    case Kind::FunctionCall:
+        return static_cast<const FunctionCallExprASTNode *>(this)->codegen(gen);
+    case Kind::For:
+        return static_cast<const ForASTNode *>(this)->codegen(gen);
+    case Kind::While:
+        return static_cast<const WhileASTNode *>(this)->codegen(gen);
+    case Kind::IfElse:
+        return static_cast<const IfElseASTNode *>(this)->codegen(gen);
+    case Kind::Break:
+        return static_cast<const BreakASTNode *>(this)->codegen(gen);
+    case Kind::FunctionExit:
+        return static_cast<const FunctionExitASTNode *>(this)->codegen(gen);
+    case Kind::ConstantDeclaration:
+        return static_cast<const ConstantDeclarationASTNode *>(this)->codegen(gen);
+    case Kind::VariableDeclaration:
+        return static_cast<const VariableDeclarationASTNode *>(this)->codegen(gen);
+    case Kind::BlockStatement:
+        return static_cast<const BlockStatmentASTNode *>(this)->codegen(gen);
+    case Kind::MainFunctionBlockStatement:
+        return static_cast<const MainFunctionBlockStatementASTNode *>(this)->codegen(gen);
+    case Kind::Prototype:
+        return static_cast<const PrototypeASTNode *>(this)->codegen(gen);
+    case Kind::Function:
+        return static_cast<const FunctionASTNode *>(this)->codegen(gen);
+    case Kind::Program:
+        return static_cast<const ProgramASTNode *>(this)->codegen(gen);
+    }
+    return nullptr;
+}
+
 void WhileASTNode::print(int level) const
 {
     printIndent(level);
@@ -65,28 +282,16 @@ void FunctionASTNode::print(int level) const
         m_body->print(level + 1);
 }
 
-void ExprASTNode::print(int level) const
-{
-    printIndent(level);
-    std::cout << "Expression Node\n";
-}
-
-void StatementASTNode::print(int level) const
-{
-    printIndent(level);
-    std::cout << "Statement Node\n";
-}
-
 void ConstantDeclarationASTNode::print(int level) const
 {
     printIndent(level);
-    std::cout << "Constant Declaration: " << m_variable << " as  " << m_value << "\n";
+    std::cout << "Constant Declaration: " << SymbolPool::global().name(m_variable).str() << " as  " << m_value << "\n";
 }
 
 void VariableASTNode::print(int level) const
 {
     printIndent(level);
-    std::cout << "Variable: " << m_identifier << "\n";
+    std::cout << "Variable: " << SymbolPool::global().name(m_identifier).str() << "\n";
 }
 
 void NumberASTNode::print(int level) const
@@ -187,14 +392,22 @@ void FunctionExitASTNode::print(int level) const
 
 llvm::Value * BreakASTNode::codegen(GenContext & gen) const
 {
-    llvm::Value * returnValue = gen.MilaBuilder.CreateBr(gen.ContinueBlock.top());
-    gen.ContinueBlock.pop();
+    if (gen.ContinueBlock.empty())
+        throw std::logic_error("break outside of a loop");
+    llvm::Value * returnValue = gen.branchTo(gen.ContinueBlock.top());
+    gen.startUnreachableBlock("afterBreak");
     return returnValue;
 }
 
 llvm::Value *FunctionExitASTNode::codegen(GenContext &gen) const
 {
-    return gen.MilaBuilder.CreateBr(gen.endBlock);
+    llvm::Value *returnValue = nullptr;
+    if (gen.endBlock)
+        returnValue = gen.branchTo(gen.endBlock);
+    else // main has no end block, exit returns 0 right away
+        returnValue = gen.MilaBuilder.CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(gen.MilaContext), 0));
+    gen.startUnreachableBlock("afterExit");
+    return returnValue;
 }
 
 llvm::Value *UnaryOperationASTNode::codegen(GenContext &gen) const
@@ -212,7 +425,7 @@ llvm::Value * IncrementExprASTNode::codegen(GenContext&gen) const
 {
     llvm::Value * LHS = m_variable->codegen(gen);
     llvm::Value * incrementValue = gen.MilaBuilder.CreateAdd(LHS,llvm::ConstantInt::get(gen.MilaContext,llvm::APInt(32,1)),"inc");
-    gen.MilaBuilder.CreateStore(incrementValue,m_variable->getStore(gen));
+    gen.writeVariable(m_variable->getName(), incrementValue);
     return nullptr;
 }
 
@@ -220,11 +433,34 @@ llvm::Value * DecrementExprASTNode::codegen(GenContext&gen) const
 {
     llvm::Value * LHS = m_variable->codegen(gen);
     llvm::Value * incrementValue = gen.MilaBuilder.CreateSub(LHS,llvm::ConstantInt::get(gen.MilaContext,llvm::APInt(32,1)),"dec");
-    gen.MilaBuilder.CreateStore(incrementValue,m_variable->getStore(gen));
+    gen.writeVariable(m_variable->getName(), incrementValue);
     return nullptr;
 }
 
 
+bool BinaryOperationASTNode::isCondition() const
+{
+    switch (m_operator)
+    {
+    case '=':
+    case tok_notequal:
+    case '<':
+    case '>':
+    case tok_lessequal:
+    case tok_greaterequal:
+        return true;
+    case tok_and:
+    case tok_or:
+    {
+        const auto *lhs = llvm::dyn_cast<BinaryOperationASTNode>(m_LHS);
+        const auto *rhs = llvm::dyn_cast<BinaryOperationASTNode>(m_RHS);
+        return lhs && rhs && lhs->isCondition() && rhs->isCondition();
+    }
+    default:
+        return false;
+    }
+}
+
 llvm::Value *BinaryOperationASTNode::codegen(GenContext &gen) const
 {
     llvm::Value *LHS = m_LHS->codegen(gen);
@@ -280,77 +516,35 @@ llvm::Value *NumberASTNode::codegen(GenContext &gen) const
 
 llvm::Value *AssignmentASTNode::codegen(GenContext &gen) const
 {
-    auto store = m_variable->getStore(gen);
+    if (gen.symbolTable.count(m_variable->getName()) <= 0)
+        throw std::logic_error("var not declared");
     auto e = m_expr->codegen(gen);
-    return gen.MilaBuilder.CreateStore(e, store);
+    gen.writeVariable(m_variable->getName(), e);
+    return e;
 }
 
 llvm::Value *VariableDeclarationASTNode::codegen(GenContext &gen) const
 {
-    if (gen.symbolTable.count(m_variable) > 0)
-        throw std::logic_error("Variable already declared");
-
-    llvm::AllocaInst *store = gen.MilaBuilder.CreateAlloca(llvm::Type::getInt32Ty(gen.MilaContext), nullptr, m_variable);
-    gen.symbolTable[m_variable] = store;
-    if (m_value)
-    {
-        auto e = m_value->codegen(gen);
-        gen.MilaBuilder.CreateStore(e, store);
-    }
-    return nullptr;
-}
-
-llvm::Value *VariableASTNode::codePtrGen(GenContext &gen) const
-{
-    if (auto it = gen.symbolTable.find(m_identifier); it != gen.symbolTable.end())
-    {
-        return it->second;
-    }
+    gen.declareVariable(m_variable, m_value ? m_value->codegen(gen) : nullptr);
     return nullptr;
 }
 
 llvm::Value *VariableASTNode::codegen(GenContext &gen) const
 {
-    if (gen.symbolTable.count(m_identifier) <= 0 && gen.constantTable.count(m_identifier) <= 0)
-    {
-        throw std::logic_error("variable not defined" );
-    }
-    if (gen.constantTable.count(m_identifier) > 0)
+    if (auto it = gen.constantTable.find(m_identifier); it != gen.constantTable.end())
     {
-        return gen.constantTable[m_identifier];
-    }
-    // if (llvm::isa<llvm::Argument>(gen.symbolTable[m_identifier]))
-    // {
-    //     return gen.symbolTable[m_identifier];
-    // }
-
-    llvm::AllocaInst *store = static_cast<llvm::AllocaInst *>(gen.symbolTable[m_identifier]);
-
-    if (auto it = gen.symbolTable.find(m_identifier); it != gen.symbolTable.end())
-    {
-        return gen.MilaBuilder.CreateLoad(llvm::Type::getInt32Ty(gen.MilaContext), it->second , m_identifier);
-    }
-    return nullptr;
-}
-
-llvm::AllocaInst *VariableASTNode::getStore(GenContext &gen) const
-{
-    if (auto it = gen.symbolTable.find(m_identifier); it != gen.symbolTable.end())
-    {
-        return static_cast<llvm::AllocaInst *>(it->second);
-    }
-    else
-    {
-        throw std::logic_error("var not declared");
+        return it->second;
     }
+    return gen.readVariable(m_identifier);
 }
 
 llvm::Function *PrototypeASTNode::codegen(GenContext &gen) const
 {
-    if (m_name == "main")
+    if (m_name == SymbolPool::sym_main)
     {
         llvm::FunctionType *functionType = llvm::FunctionType::get(llvm::Type::getInt32Ty(gen.MilaContext), false);
         llvm::Function *mainFunction = llvm::Function::Create(functionType, llvm::Function::ExternalLinkage, "main", gen.MilaModule);
+        gen.functionTable[m_name] = mainFunction;
         // block
         return mainFunction;
     }
@@ -367,22 +561,77 @@ llvm::Function *PrototypeASTNode::codegen(GenContext &gen) const
     }
 
     llvm::Function *F =
-        llvm::Function::Create(FT, llvm::Function::ExternalLinkage, m_name, gen.MilaModule);
+        llvm::Function::Create(FT, llvm::Function::ExternalLinkage, SymbolPool::global().name(m_name), gen.MilaModule);
+    gen.functionTable[m_name] = F;
 
 
 
 
     unsigned index = 0;
     for (auto &Arg : F->args())
-        Arg.setName(m_args[index++]);
+        Arg.setName(SymbolPool::global().name(m_args[index++]));
     return F;
 }
 
+// statements of a block are in tail position when the block is or when exit follows them
+static void findTailCalls(const ASTNode *node, bool tail, const PrototypeASTNode &prototype,
+                          llvm::SmallPtrSetImpl<const FunctionCallExprASTNode *> &calls)
+{
+    if (!node)
+        return;
+    switch (node->getKind())
+    {
+    case ASTNode::Kind::BlockStatement:
+    case ASTNode::Kind::MainFunctionBlockStatement:
+    {
+        llvm::ArrayRef<ExprASTNode *> statements = llvm::isa<BlockStatmentASTNode>(node) ? llvm::cast<BlockStatmentASTNode>(node)->getExpressions()
+                                                                                         : llvm::cast<MainFunctionBlockStatementASTNode>(node)->getExpressions();
+        for (size_t i = 0; i < statements.size(); ++i)
+        {
+            bool last = i + 1 == statements.size();
+            findTailCalls(statements[i], last ? tail : llvm::isa_and_nonnull<FunctionExitASTNode>(statements[i + 1]), prototype, calls);
+        }
+        return;
+    }
+    case ASTNode::Kind::IfElse:
+        findTailCalls(llvm::cast<IfElseASTNode>(node)->getThen(), tail, prototype, calls);
+        findTailCalls(llvm::cast<IfElseASTNode>(node)->getElse(), tail, prototype, calls);
+        return;
+    case ASTNode::Kind::While:
+        findTailCalls(llvm::cast<WhileASTNode>(node)->getBody(), false, prototype, calls);
+        return;
+    case ASTNode::Kind::For:
+        findTailCalls(llvm::cast<ForASTNode>(node)->getBody(), false, prototype, calls);
+        return;
+    case ASTNode::Kind::Assignment:
+    {
+        const auto *assignment = llvm::cast<AssignmentASTNode>(node);
+        const auto *call = llvm::dyn_cast<FunctionCallExprASTNode>(assignment->getExpr());
+        if (tail && call && prototype.m_type == PrototypeASTNode::FUNCTION && assignment->getVariable()->getName() == prototype.getName())
+            calls.insert(call);
+        return;
+    }
+    case ASTNode::Kind::FunctionCall:
+        if (tail && prototype.m_type == PrototypeASTNode::PROCEDURE)
+            calls.insert(llvm::cast<FunctionCallExprASTNode>(node));
+        return;
+    default:
+        return;
+    }
+}
+
+void FunctionASTNode::collectTailCalls(llvm::SmallPtrSetImpl<const FunctionCallExprASTNode *> &calls) const
+{
+    // main returns 0, whatever it calls last
+    if (m_prototype->getName() != SymbolPool::sym_main)
+        findTailCalls(m_body, true, *m_prototype, calls);
+}
+
 llvm::Function *FunctionASTNode::codegen(GenContext &gen) const
 {
 
     gen.endBlock = nullptr;
-    llvm::Function *function = gen.MilaModule.getFunction(m_prototype->getName());
+    llvm::Function *function = gen.functionTable.lookup(m_prototype->getName());
     if (!function)
     {
         function = m_prototype->codegen(gen);
@@ -396,9 +645,13 @@ llvm::Function *FunctionASTNode::codegen(GenContext &gen) const
     if (!m_body)
         return function;
 
-    if (m_prototype->getName() == "main")
+    gen.ssa.reset();
+    gen.tailCalls.clear();
+    collectTailCalls(gen.tailCalls);
+    if (m_prototype->getName() == SymbolPool::sym_main)
     {
         llvm::BasicBlock *BB = llvm::BasicBlock::Create(gen.MilaContext, "entry", function);
+        gen.sealBlock(BB);
         gen.MilaBuilder.SetInsertPoint(BB);
         gen.symbolTable.clear();
         gen.constantTable.clear();
@@ -419,22 +672,21 @@ llvm::Function *FunctionASTNode::codegen(GenContext &gen) const
     llvm::BasicBlock *BB = llvm::BasicBlock::Create(gen.MilaContext, "entry", function);
     llvm::BasicBlock *endBB = llvm::BasicBlock::Create(gen.MilaContext, "end", function);
     gen.endBlock = endBB;
+    gen.sealBlock(BB);
     gen.MilaBuilder.SetInsertPoint(BB);
     gen.symbolTable.clear();
     gen.constantTable.clear();
+    unsigned index = 0;
     for (auto &Arg : function->args())
-    {
-        llvm::AllocaInst * arg = gen.MilaBuilder.CreateAlloca(Arg.getType(),nullptr,Arg.getName());
-        gen.MilaBuilder.CreateStore(&Arg,arg);
-        gen.symbolTable[std::string(Arg.getName())] = arg;
-    }
+        gen.declareVariable(m_prototype->getArgs()[index++], &Arg);
     m_prototype->getReturnValue()->codegen(gen);
     for (auto &variable : m_variables)
         variable->codegen(gen);
     for (auto &constant : m_constants)
         constant->codegen(gen);
     m_body->codegen(gen);
-    gen.MilaBuilder.CreateBr(endBB);
+    gen.branchTo(endBB);
+    gen.sealBlock(endBB);
 
     if (m_prototype->m_type == PrototypeASTNode::PROCEDURE)
     {
@@ -450,9 +702,8 @@ llvm::Function *FunctionASTNode::codegen(GenContext &gen) const
     //     llvm::verifyFunction(*function);
     //     return function;
     // }
-    auto it = gen.symbolTable.find(m_prototype->getName());
     gen.MilaBuilder.SetInsertPoint(endBB);
-    llvm::Value *retValue = gen.MilaBuilder.CreateLoad(llvm::Type::getInt32Ty(gen.MilaContext), it->second);
+    llvm::Value *retValue = gen.readVariable(m_prototype->getName());
     gen.MilaBuilder.CreateRet(retValue);
     llvm::verifyFunction(*function);
     return function;
@@ -495,16 +746,22 @@ llvm::Value *MainFunctionBlockStatementASTNode::codegen(GenContext &gen) const
 
 llvm::Value *ReadlnExprASTNode::codegen(GenContext &gen) const
 {
-    llvm::Function *calleeF = gen.MilaModule.getFunction("readln");
-    std::vector<llvm::Value *> argsV;
-    argsV.push_back(m_variable->codePtrGen(gen));
-    return gen.MilaBuilder.CreateCall(calleeF, argsV, "readln");
+    // stored like an assignment, the variable keeps its value when no number was read (scanf)
+    SymbolId name = m_variable->getName();
+    llvm::Value *read = gen.MilaBuilder.CreateCall(gen.functionTable.lookup(SymbolPool::sym_readln), {}, "readln");
+    llvm::Type *int32 = llvm::Type::getInt32Ty(gen.MilaContext);
+    llvm::Value *value = gen.MilaBuilder.CreateTrunc(read, int32, "read");
+    llvm::Value *status = gen.MilaBuilder.CreateTrunc(gen.MilaBuilder.CreateLShr(read, 32, "high"), int32, "status");
+    llvm::Value *stored = gen.MilaBuilder.CreateICmpEQ(status, llvm::ConstantInt::get(int32, 1), "stored");
+    llvm::Value *result = gen.MilaBuilder.CreateSelect(stored, value, gen.readVariable(name), SymbolPool::global().name(name));
+    gen.writeVariable(name, result);
+    return result;
 }
 
 llvm::Value *FunctionCallExprASTNode::codegen(GenContext &gen) const
 {
     // lookup the fucntion name in the global table , not found > function not defined
-    llvm::Function *calleeF = gen.MilaModule.getFunction(m_callee);
+    llvm::Function *calleeF = gen.functionTable.lookup(m_callee);
     if (!calleeF)
         throw std::logic_error("Function not defined");
     // check the argument matching
@@ -517,42 +774,95 @@ llvm::Value *FunctionCallExprASTNode::codegen(GenContext &gen) const
         if (!argsV.back())
             return nullptr;
     }
-    if(calleeF->getFunctionType()->getReturnType()->isVoidTy())
+    // void calls cannot have a name
+    bool isVoid = calleeF->getFunctionType()->getReturnType()->isVoidTy();
+    llvm::CallInst *call = gen.MilaBuilder.CreateCall(calleeF, argsV, isVoid ? llvm::StringRef() : SymbolPool::global().name(m_callee));
+    if (!gen.tailCalls.count(this))
+        return call;
+
+    // the function returns what this call does, right after it. With equal prototypes musttail reuses the
+    // caller's frame in any calling convention; other tail calls are guaranteed between fastcc functions
+    // (internalizeFunctions), a procedure calling a function can only hint
+    llvm::Function *caller = gen.MilaBuilder.GetInsertBlock()->getParent();
+    if (caller->getReturnType() != calleeF->getReturnType())
     {
-        return gen.MilaBuilder.CreateCall(calleeF, argsV);
-        // Return null for void functions
+        call->setTailCall();
+        return call;
     }
-
-    return gen.MilaBuilder.CreateCall(calleeF, argsV, m_callee);
-}
-
-llvm::Value * ForASTNode::codegen(GenContext & gen) const
+    call->setTailCallKind(caller->getFunctionType() == calleeF->getFunctionType() ? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+    if (isVoid)
+        gen.MilaBuilder.CreateRetVoid();
+    else
+        gen.MilaBuilder.CreateRet(call);
+    gen.startUnreachableBlock("afterTailCall");
+    return call;
+}
+
+/*
+ * A counted loop in the form the loop passes expect: the bound evaluated once
+ * before the loop, a preheader, the body as header with the only phi of the
+ * counter, a test that leaves after the iteration for the bound and a latch
+ * with the back edge. Only the latch increments, and only below the bound, so
+ * its increment is nsw and loops up to maxint end. As before the increment
+ * starts from the value the iteration began with, whatever the body assigned,
+ * and a completed loop leaves the variable one past the bound, computed on
+ * the exit edge with wrapping arithmetic like the interpreter.
+ */
+llvm::Value *ForASTNode::codegen(GenContext &gen) const
 {
-    llvm::Function * TheFunction = gen.MilaBuilder.GetInsertBlock()->getParent();
-    llvm::BasicBlock * conditionBB = llvm::BasicBlock::Create(gen.MilaContext , "forCond" , TheFunction);
-    llvm::BasicBlock * forContinueBB = llvm::BasicBlock::Create(gen.MilaContext , "forContinue" , TheFunction);
-    gen.ContinueBlock.push(forContinueBB);
+    llvm::Function *TheFunction = gen.MilaBuilder.GetInsertBlock()->getParent();
+    llvm::Type *int32 = llvm::Type::getInt32Ty(gen.MilaContext);
     m_assign->codegen(gen);
-    gen.MilaBuilder.CreateBr(conditionBB);
-    gen.MilaBuilder.SetInsertPoint(conditionBB);
-    if(gen.symbolTable.count(m_variable) <= 0 )return nullptr;
-    llvm::Value * variable = gen.MilaBuilder.CreateLoad(llvm::Type::getInt32Ty(gen.MilaContext),gen.symbolTable[m_variable],m_variable);
-    llvm::Value * condition = nullptr;
-    llvm::Value * RHS = m_expr->codegen(gen);
-    if(m_type == TO) condition = gen.MilaBuilder.CreateICmpSLE(variable,RHS,"condition");
-    else condition = gen.MilaBuilder.CreateICmpSGE(variable,RHS,"condition");
-    condition = gen.MilaBuilder.CreateICmpNE(condition,llvm::ConstantInt::get(gen.MilaContext,llvm::APInt(1,0)) , "forCond");
-    llvm::BasicBlock * forBodyBB = llvm::BasicBlock::Create(gen.MilaContext ,"forbody",TheFunction);
-    gen.MilaBuilder.CreateCondBr(condition,forBodyBB,forContinueBB);
+    llvm::Value *start = gen.readVariable(m_variable);
+    llvm::Value *bound = m_expr->codegen(gen);
+    llvm::Value *enter = m_type == TO ? gen.MilaBuilder.CreateICmpSLE(start, bound, "forEnter") : gen.MilaBuilder.CreateICmpSGE(start, bound, "forEnter");
+
+    llvm::BasicBlock *preheaderBB = llvm::BasicBlock::Create(gen.MilaContext, "forPreheader", TheFunction);
+    llvm::BasicBlock *forBodyBB = llvm::BasicBlock::Create(gen.MilaContext, "forbody", TheFunction);
+    llvm::BasicBlock *testBB = llvm::BasicBlock::Create(gen.MilaContext, "forTest", TheFunction);
+    llvm::BasicBlock *latchBB = llvm::BasicBlock::Create(gen.MilaContext, "forLatch", TheFunction);
+    llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(gen.MilaContext, "forDone", TheFunction);
+    llvm::BasicBlock *forContinueBB = llvm::BasicBlock::Create(gen.MilaContext, "forContinue", TheFunction);
+    gen.MilaBuilder.CreateCondBr(enter, preheaderBB, forContinueBB);
+    gen.sealBlock(preheaderBB);
+    gen.MilaBuilder.SetInsertPoint(preheaderBB);
+    gen.MilaBuilder.CreateBr(forBodyBB);
+
+    // forBodyBB is sealed only after the back edge exists, so this stays a phi until then
     gen.MilaBuilder.SetInsertPoint(forBodyBB);
+    llvm::Value *variable = gen.readVariable(m_variable);
+    gen.ContinueBlock.push(forContinueBB);
     m_body->codegen(gen);
-    llvm::Value * afterForBody = nullptr;
-    if(m_type == TO ) afterForBody = gen.MilaBuilder.CreateAdd(variable,llvm::ConstantInt::get(gen.MilaContext,llvm::APInt(32,1)),"AfterForBody");
-    else afterForBody = gen.MilaBuilder.CreateSub(variable,llvm::ConstantInt::get(gen.MilaContext,llvm::APInt(32,1)),"AfterForBody");
-    gen.MilaBuilder.CreateStore(afterForBody,gen.symbolTable[m_variable]);
-    gen.MilaBuilder.CreateBr(conditionBB);
+    gen.ContinueBlock.pop();
+    gen.branchTo(testBB);
+
+    gen.sealBlock(testBB);
+    gen.MilaBuilder.SetInsertPoint(testBB);
+    llvm::Value *last = gen.MilaBuilder.CreateICmpEQ(variable, bound, "forLast");
+    gen.MilaBuilder.CreateCondBr(last, doneBB, latchBB);
+
+    llvm::Value *one = llvm::ConstantInt::get(int32, 1);
+    gen.sealBlock(latchBB);
+    gen.MilaBuilder.SetInsertPoint(latchBB);
+    llvm::Value *next = m_type == TO ? gen.MilaBuilder.CreateNSWAdd(variable, one, "forNext") : gen.MilaBuilder.CreateNSWSub(variable, one, "forNext");
+    gen.writeVariable(m_variable, next);
+    llvm::BranchInst *backEdge = gen.MilaBuilder.CreateBr(forBodyBB);
+    // the loop ends: a body without side effects may be deleted
+    llvm::MDNode *progress = llvm::MDNode::get(gen.MilaContext, llvm::MDString::get(gen.MilaContext, "llvm.loop.mustprogress"));
+    llvm::MDNode *loopID = llvm::MDNode::getDistinct(gen.MilaContext, {nullptr, progress});
+    loopID->replaceOperandWith(0, loopID);
+    backEdge->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+
+    // past the bound, which may be maxint (minint for downto)
+    gen.sealBlock(doneBB);
+    gen.MilaBuilder.SetInsertPoint(doneBB);
+    llvm::Value *after = m_type == TO ? gen.MilaBuilder.CreateAdd(variable, one, "forAfter") : gen.MilaBuilder.CreateSub(variable, one, "forAfter");
+    gen.writeVariable(m_variable, after);
+    gen.MilaBuilder.CreateBr(forContinueBB);
+
+    gen.sealBlock(forBodyBB);
+    gen.sealBlock(forContinueBB);
     gen.MilaBuilder.SetInsertPoint(forContinueBB);
-
     return nullptr;
 }
 
@@ -562,29 +872,25 @@ llvm::Value *WhileASTNode::codegen(GenContext &gen) const
     llvm::BasicBlock *conditionBB = llvm::BasicBlock::Create(gen.MilaContext, "whileCond", TheFunction);
     llvm::BasicBlock *whileContinueBB = llvm::BasicBlock::Create(gen.MilaContext, "merge", TheFunction);
     gen.ContinueBlock.push(whileContinueBB);
-    gen.MilaBuilder.CreateBr(conditionBB);
+    gen.branchTo(conditionBB);
     gen.MilaBuilder.SetInsertPoint(conditionBB);
-    llvm::Value *condition = m_condition->codegen(gen);
-    if (!condition)
-        return nullptr;
-    condition = gen.MilaBuilder.CreateICmpNE(condition, llvm::ConstantInt::get(gen.MilaContext, llvm::APInt(1, 0)), "whileCond");
     llvm::BasicBlock *whileBodyBB = llvm::BasicBlock::Create(gen.MilaContext, "whilebody", TheFunction);
-    gen.MilaBuilder.CreateCondBr(condition, whileBodyBB, whileContinueBB);
+    if (!gen.branchOn(m_condition, whileBodyBB, whileContinueBB, "whileCond"))
+        return nullptr;
+    gen.sealBlock(whileBodyBB);
     gen.MilaBuilder.SetInsertPoint(whileBodyBB);
     m_body->codegen(gen);
-    gen.MilaBuilder.CreateBr(conditionBB);
+    gen.branchTo(conditionBB);
+    gen.sealBlock(conditionBB);
+    gen.sealBlock(whileContinueBB);
     gen.MilaBuilder.SetInsertPoint(whileContinueBB);
+    gen.ContinueBlock.pop();
 
     return nullptr;
 }
 
 llvm::Value *IfElseASTNode::codegen(GenContext &gen) const
 {
-    llvm::Value *condition = m_condition->codegen(gen);
-    if (!condition)
-        return nullptr;
-    // condition = gen.MilaBuilder.CreateZExt(condition,llvm::Type::getInt32Ty(gen.MilaContext));
-    condition = gen.MilaBuilder.CreateICmpNE(condition, llvm::ConstantInt::get(gen.MilaContext, llvm::APInt(1, 0)), "ifcond");
     llvm::Function *TheFunction = gen.MilaBuilder.GetInsertBlock()->getParent();
 
     llvm::BasicBlock *ThenBB =
@@ -592,19 +898,23 @@ llvm::Value *IfElseASTNode::codegen(GenContext &gen) const
     llvm::BasicBlock *ElseBB = nullptr;
     ElseBB = llvm::BasicBlock::Create(gen.MilaContext, "else", TheFunction);
     llvm::BasicBlock *MergeBB = llvm::BasicBlock::Create(gen.MilaContext, "ifcont", TheFunction);
-    gen.MilaBuilder.CreateCondBr(condition, ThenBB, ElseBB);
+    if (!gen.branchOn(m_condition, ThenBB, ElseBB, "ifcond"))
+        return nullptr;
+    gen.sealBlock(ThenBB);
+    gen.sealBlock(ElseBB);
     gen.MilaBuilder.SetInsertPoint(ThenBB);
 
-    llvm::Value *ThenV = m_then->codegen(gen);
-    gen.MilaBuilder.CreateBr(MergeBB);
+    m_then->codegen(gen);
+    gen.branchTo(MergeBB);
 
     //   // Codegen of 'Then' can change the current block, update ThenBB for the PHI.
     //   ThenBB = gen.MilaBuilder.GetInsertBlock();
 
     gen.MilaBuilder.SetInsertPoint(ElseBB);
     if (m_else)
-        llvm::Value *elseV = m_else->codegen(gen);
-    gen.MilaBuilder.CreateBr(MergeBB);
+        m_else->codegen(gen);
+    gen.branchTo(MergeBB);
+    gen.sealBlock(MergeBB);
     gen.MilaBuilder.SetInsertPoint(MergeBB);
     return nullptr;
 }
\ No newline at end of file
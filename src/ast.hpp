@@ -1,10 +1,17 @@
 #ifndef PJPPROJECT_AST_HPP
 #define PJPPROJECT_AST_HPP
 
+#include "Arena.hpp"
 #include "Lexer.hpp"
+#include "SSABuilder.hpp"
+#include "SymbolPool.hpp"
 #include <llvm/ADT/APFloat.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
@@ -14,68 +21,141 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <stack>
 
 #include <vector>
-using SymbolTable = std::map<std::string, llvm::Value *>;
-using ConstantValueTable = std::map<std::string, llvm::Constant *>;
+using SymbolTable = llvm::DenseSet<SymbolId>;
+using ConstantValueTable = llvm::DenseMap<SymbolId, llvm::Constant *>;
+using FunctionTable = llvm::DenseMap<SymbolId, llvm::Function *>;
+
+class ExprASTNode;
+class FunctionCallExprASTNode;
 
 class GenContext
 {
 
 public:
   GenContext();
-  llvm::LLVMContext MilaContext; // llvm context
-  llvm::IRBuilder<> MilaBuilder; // llvm builder
-  llvm::Module MilaModule;       // llvm module
-  SymbolTable symbolTable;
+  // declarations of the runtime functions (fce.c) the generated code calls
+  void declareRuntime();
+  // continues after a terminator (break, exit) in a fresh block without predecessors
+  void startUnreachableBlock(const char *name);
+  // branches to target, unless the current block is dead code after break or exit: that one
+  // ends in unreachable, so it does not become a predecessor of target
+  llvm::Instruction *branchTo(llvm::BasicBlock *target);
+  // branches on condition (if, while): and/or of comparisons short-circuit, the right operand
+  // only runs when the left one does not decide; false if the condition generated no value
+  bool branchOn(const ExprASTNode *condition, llvm::BasicBlock *ifTrue, llvm::BasicBlock *ifFalse, const char *name);
+
+  // local variables, all of them SSA values
+  void declareVariable(SymbolId name, llvm::Value *initial);
+  llvm::Value *readVariable(SymbolId name);
+  void writeVariable(SymbolId name, llvm::Value *value);
+  // no more edges will be added into block
+  void sealBlock(llvm::BasicBlock *block) { ssa.sealBlock(block); }
+
+  // owned through pointers so that the module can outlive the code generator (see Parser::takeModule)
+  std::unique_ptr<llvm::LLVMContext> ContextOwner;
+  std::unique_ptr<llvm::Module> ModuleOwner;
+  llvm::LLVMContext &MilaContext; // llvm context
+  llvm::IRBuilder<> MilaBuilder;  // llvm builder
+  llvm::Module &MilaModule;       // llvm module
+  SymbolTable symbolTable;       // declared variables, their values live in ssa
+  SSABuilder ssa;
   llvm::BasicBlock *endBlock = nullptr;
+  llvm::SmallPtrSet<const FunctionCallExprASTNode *, 4> tailCalls; // of the current function, see FunctionASTNode::collectTailCalls
   std::stack<llvm::BasicBlock *> ContinueBlock;
   ConstantValueTable constantTable;
+  FunctionTable functionTable;
 };
 
+/*
+ * Nodes carry a kind tag instead of a vtable. codegen and print switch on the
+ * tag and call the concrete node's method directly, which also allows
+ * llvm::isa/dyn_cast on nodes. Nodes live in the parser's Arena and are never
+ * destroyed individually.
+ */
 class ASTNode
 {
 public:
-  virtual ~ASTNode() = default;
-  virtual void print(int level = 0) const = 0;
-  virtual llvm::Value *codegen(GenContext &gen) const = 0;
+  enum class Kind : std::uint8_t
+  {
+    // expressions
+    Variable,
+    Assignment,
+    Number,
+    UnaryOperation,
+    BinaryOperation,
+    Increment,
+    Decrement,
+    Readln,
+    FunctionCall,
+    For,
+    While,
+    IfElse,
+    Break,
+    FunctionExit,
+    // statements
+    ConstantDeclaration,
+    VariableDeclaration,
+    BlockStatement,
+    MainFunctionBlockStatement,
+    //
+    Prototype,
+    Function,
+    Program
+  };
+
+  Kind getKind() const { return m_kind; }
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &gen) const;
 
 protected:
+  explicit ASTNode(Kind kind) : m_kind(kind) {}
   void printIndent(int level) const;
+
+private:
+  const Kind m_kind;
 };
 
 // expressions
 class ExprASTNode : public ASTNode
 {
 public:
-  virtual ~ExprASTNode(){};
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() <= Kind::FunctionExit; }
+
+protected:
+  explicit ExprASTNode(Kind kind) : ASTNode(kind) {}
 };
 
 class VariableASTNode : public ExprASTNode
 {
-  const std::string m_identifier;
+  const SymbolId m_identifier;
 
 public:
-  VariableASTNode(const std::string &name) : m_identifier(name) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  llvm::Value *codePtrGen(GenContext &gen) const;
-  virtual void print(int level = 0) const override;
-  llvm::AllocaInst *getStore(GenContext &gen) const;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Variable; }
+  VariableASTNode(SymbolId name) : ExprASTNode(Kind::Variable), m_identifier(name) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  SymbolId getName() const { return m_identifier; }
 };
 
 class AssignmentASTNode : public ExprASTNode
 {
-  std::unique_ptr<VariableASTNode> m_variable;
-  std::unique_ptr<ExprASTNode> m_expr;
+  VariableASTNode *m_variable;
+  ExprASTNode *m_expr;
 
 public:
-  AssignmentASTNode(std::unique_ptr<VariableASTNode> variable, std::unique_ptr<ExprASTNode> expression)
-      : m_variable(std::move(variable)), m_expr(std::move(expression)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Assignment; }
+  AssignmentASTNode(VariableASTNode *variable, ExprASTNode *expression)
+      : ExprASTNode(Kind::Assignment), m_variable(variable), m_expr(expression) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  VariableASTNode *getVariable() const { return m_variable; }
+  ExprASTNode *getExpr() const { return m_expr; }
 };
 
 class NumberASTNode : public ExprASTNode
@@ -83,74 +163,94 @@ class NumberASTNode : public ExprASTNode
   int m_value;
 
 public:
-  NumberASTNode(int value) : m_value(value) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Number; }
+  NumberASTNode(int value) : ExprASTNode(Kind::Number), m_value(value) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  int getValue() const { return m_value; }
 };
 
 class UnaryOperationASTNode : public ExprASTNode
 {
   int m_operator;
-  std::unique_ptr<ExprASTNode> m_expr;
+  ExprASTNode *m_expr;
 
 public:
-  UnaryOperationASTNode(int op, std::unique_ptr<ExprASTNode> expression) : m_operator(op), m_expr(std::move(expression)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::UnaryOperation; }
+  UnaryOperationASTNode(int op, ExprASTNode *expression) : ExprASTNode(Kind::UnaryOperation), m_operator(op), m_expr(expression) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  int getOperator() const { return m_operator; }
+  ExprASTNode *getExpr() const { return m_expr; }
 };
 
 class BinaryOperationASTNode : public ExprASTNode
 {
   int m_operator;
-  std::unique_ptr<ExprASTNode> m_LHS;
-  std::unique_ptr<ExprASTNode> m_RHS;
+  ExprASTNode *m_LHS;
+  ExprASTNode *m_RHS;
 
 public:
-  BinaryOperationASTNode(int operatorType, std::unique_ptr<ExprASTNode> LHS, std::unique_ptr<ExprASTNode> RHS)
-      : m_operator(operatorType), m_LHS(std::move(LHS)), m_RHS(std::move(RHS)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::BinaryOperation; }
+  BinaryOperationASTNode(int operatorType, ExprASTNode *LHS, ExprASTNode *RHS)
+      : ExprASTNode(Kind::BinaryOperation), m_operator(operatorType), m_LHS(LHS), m_RHS(RHS) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  int getOperator() const { return m_operator; }
+  // a comparison, or and/or of two conditions; and/or of integers stay bitwise
+  bool isCondition() const;
+  ExprASTNode *getLHS() const { return m_LHS; }
+  ExprASTNode *getRHS() const { return m_RHS; }
 };
 
 class IncrementExprASTNode : public ExprASTNode
 {
-  std::unique_ptr<VariableASTNode> m_variable;
+  VariableASTNode *m_variable;
 
 public:
-  IncrementExprASTNode(std::unique_ptr<VariableASTNode> variable) : m_variable(std::move(variable)) {}
-  virtual void print(int level = 0) const override;
-  llvm::Value *codegen(GenContext &gen) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Increment; }
+  IncrementExprASTNode(VariableASTNode *variable) : ExprASTNode(Kind::Increment), m_variable(variable) {}
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &gen) const;
+  VariableASTNode *getVariable() const { return m_variable; }
 };
 
 class DecrementExprASTNode : public ExprASTNode
 {
-  std::unique_ptr<VariableASTNode> m_variable;
+  VariableASTNode *m_variable;
 
 public:
-  DecrementExprASTNode(std::unique_ptr<VariableASTNode> variable) : m_variable(std::move(variable)) {}
-  virtual void print(int level = 0) const override;
-  llvm::Value *codegen(GenContext &gen) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Decrement; }
+  DecrementExprASTNode(VariableASTNode *variable) : ExprASTNode(Kind::Decrement), m_variable(variable) {}
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &gen) const;
+  VariableASTNode *getVariable() const { return m_variable; }
 };
 
 class ReadlnExprASTNode : public ExprASTNode
 {
-  std::unique_ptr<VariableASTNode> m_variable;
+  VariableASTNode *m_variable;
 
 public:
-  ReadlnExprASTNode(std::unique_ptr<VariableASTNode> variable) : m_variable(std::move(variable)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Readln; }
+  ReadlnExprASTNode(VariableASTNode *variable) : ExprASTNode(Kind::Readln), m_variable(variable) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  VariableASTNode *getVariable() const { return m_variable; }
 };
 
 class FunctionCallExprASTNode : public ExprASTNode
 {
-  std::string m_callee;
-  std::vector<std::unique_ptr<ExprASTNode>> m_args;
+  SymbolId m_callee;
+  llvm::ArrayRef<ExprASTNode *> m_args;
 
 public:
-  FunctionCallExprASTNode(std::string callee, std::vector<std::unique_ptr<ExprASTNode>> args) : m_callee(callee), m_args(std::move(args)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::FunctionCall; }
+  FunctionCallExprASTNode(SymbolId callee, llvm::ArrayRef<ExprASTNode *> args) : ExprASTNode(Kind::FunctionCall), m_callee(callee), m_args(args) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  SymbolId getCallee() const { return m_callee; }
+  llvm::ArrayRef<ExprASTNode *> getArgs() const { return m_args; }
 };
 
 class VariableDeclarationASTNode;
@@ -164,109 +264,136 @@ public:
     TO,
     DOWNTO
   };
-  ForASTNode(std::string variable, std::unique_ptr<ExprASTNode> assign, Type type, std::unique_ptr<ExprASTNode> expr, std::unique_ptr<ASTNode> body)
-      : m_variable(variable), m_assign(std::move(assign)), m_type(type), m_expr(std::move(expr)), m_body(std::move(body)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::For; }
+  ForASTNode(SymbolId variable, ExprASTNode *assign, Type type, ExprASTNode *expr, ASTNode *body)
+      : ExprASTNode(Kind::For), m_variable(variable), m_assign(assign), m_type(type), m_expr(expr), m_body(body) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  SymbolId getVariable() const { return m_variable; }
+  ExprASTNode *getAssign() const { return m_assign; }
+  Type getType() const { return m_type; }
+  ExprASTNode *getBound() const { return m_expr; }
+  ASTNode *getBody() const { return m_body; }
 
 private:
-  std::string m_variable;
-  std::unique_ptr<ExprASTNode> m_assign;
+  SymbolId m_variable;
+  ExprASTNode *m_assign;
   Type m_type;
-  std::unique_ptr<ExprASTNode> m_expr;
-  std::unique_ptr<ASTNode> m_body;
+  ExprASTNode *m_expr;
+  ASTNode *m_body;
 };
 
 class WhileASTNode : public ExprASTNode
 {
-  std::unique_ptr<ExprASTNode> m_condition;
-  std::unique_ptr<ASTNode> m_body;
+  ExprASTNode *m_condition;
+  ASTNode *m_body;
 
 public:
-  WhileASTNode(std::unique_ptr<ExprASTNode> condition, std::unique_ptr<ASTNode> body)
-      : m_condition(std::move(condition)), m_body(std::move(body)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::While; }
+  WhileASTNode(ExprASTNode *condition, ASTNode *body)
+      : ExprASTNode(Kind::While), m_condition(condition), m_body(body) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  ExprASTNode *getCondition() const { return m_condition; }
+  ASTNode *getBody() const { return m_body; }
 };
 
 class IfElseASTNode : public ExprASTNode
 {
-  std::unique_ptr<ExprASTNode> m_condition;
-  std::unique_ptr<ASTNode> m_then;
-  std::unique_ptr<ASTNode> m_else;
+  ExprASTNode *m_condition;
+  ASTNode *m_then;
+  ASTNode *m_else;
 
 public:
-  IfElseASTNode(std::unique_ptr<ExprASTNode> condition, std::unique_ptr<ASTNode> then, std::unique_ptr<ASTNode> elsebranch)
-      : m_condition(std::move(condition)), m_then(std::move(then)), m_else(std::move(elsebranch)) {}
-  virtual void print(int level = 0) const override;
-  virtual llvm::Value *codegen(GenContext &gen) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::IfElse; }
+  IfElseASTNode(ExprASTNode *condition, ASTNode *then, ASTNode *elsebranch)
+      : ExprASTNode(Kind::IfElse), m_condition(condition), m_then(then), m_else(elsebranch) {}
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &gen) const;
+  ExprASTNode *getCondition() const { return m_condition; }
+  ASTNode *getThen() const { return m_then; }
+  ASTNode *getElse() const { return m_else; }
 };
 
 class BreakASTNode : public ExprASTNode
 {
 public:
-  BreakASTNode() {}
-  virtual void print(int level = 0) const override;
-  virtual llvm::Value *codegen(GenContext &gen) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Break; }
+  BreakASTNode() : ExprASTNode(Kind::Break) {}
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &gen) const;
 };
 
 class FunctionExitASTNode : public ExprASTNode
 {
 public:
-  FunctionExitASTNode() {}
-  virtual void print(int level = 0) const override;
-  virtual llvm::Value *codegen(GenContext &gen) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::FunctionExit; }
+  FunctionExitASTNode() : ExprASTNode(Kind::FunctionExit) {}
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &gen) const;
 };
 
 // statements
 class StatementASTNode : public ASTNode
 {
 public:
-  virtual ~StatementASTNode(){};
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() >= Kind::ConstantDeclaration && node->getKind() <= Kind::MainFunctionBlockStatement; }
+
+protected:
+  explicit StatementASTNode(Kind kind) : ASTNode(kind) {}
 };
 
 class ConstantDeclarationASTNode : public StatementASTNode
 {
-  std::string m_variable;
+  SymbolId m_variable;
   int m_value;
 
 public:
-  ConstantDeclarationASTNode(std::string variable,
-                             int value) : m_variable(variable), m_value(value) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::ConstantDeclaration; }
+  ConstantDeclarationASTNode(SymbolId variable,
+                             int value) : StatementASTNode(Kind::ConstantDeclaration), m_variable(variable), m_value(value) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  SymbolId getName() const { return m_variable; }
+  int getValue() const { return m_value; }
 };
 
 class VariableDeclarationASTNode : public StatementASTNode
 {
-  std::string m_variable;
-  std::unique_ptr<ExprASTNode> m_value;
+  SymbolId m_variable;
+  ExprASTNode *m_value;
 
 public:
-  VariableDeclarationASTNode(std::string variable, std::unique_ptr<ExprASTNode> value) : m_variable(variable), m_value(std::move(value)) {}
-  virtual void print(int level = 0) const override;
-  virtual llvm::Value *codegen(GenContext &) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::VariableDeclaration; }
+  VariableDeclarationASTNode(SymbolId variable, ExprASTNode *value) : StatementASTNode(Kind::VariableDeclaration), m_variable(variable), m_value(value) {}
+  void print(int level = 0) const;
+  llvm::Value *codegen(GenContext &) const;
+  SymbolId getName() const { return m_variable; }
+  ExprASTNode *getValue() const { return m_value; }
 };
 
 class BlockStatmentASTNode : public StatementASTNode
 {
-  std::vector<std::unique_ptr<ExprASTNode>> m_expresions;
+  llvm::ArrayRef<ExprASTNode *> m_expresions;
 
 public:
-  BlockStatmentASTNode(std::vector<std::unique_ptr<ExprASTNode>> expresions) : m_expresions(std::move(expresions)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::BlockStatement; }
+  BlockStatmentASTNode(llvm::ArrayRef<ExprASTNode *> expresions) : StatementASTNode(Kind::BlockStatement), m_expresions(expresions) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  llvm::ArrayRef<ExprASTNode *> getExpressions() const { return m_expresions; }
 };
 
 class MainFunctionBlockStatementASTNode : public StatementASTNode
 {
-  std::vector<std::unique_ptr<ExprASTNode>> m_expresions;
+  llvm::ArrayRef<ExprASTNode *> m_expresions;
 
 public:
-  MainFunctionBlockStatementASTNode(std::vector<std::unique_ptr<ExprASTNode>> expresions) : m_expresions(std::move(expresions)) {}
-  llvm::Value *codegen(GenContext &gen) const override;
-  virtual void print(int level = 0) const override;
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::MainFunctionBlockStatement; }
+  MainFunctionBlockStatementASTNode(llvm::ArrayRef<ExprASTNode *> expresions) : StatementASTNode(Kind::MainFunctionBlockStatement), m_expresions(expresions) {}
+  llvm::Value *codegen(GenContext &gen) const;
+  void print(int level = 0) const;
+  llvm::ArrayRef<ExprASTNode *> getExpressions() const { return m_expresions; }
 };
 
 //
@@ -281,43 +408,55 @@ public:
     PROCEDURE
   };
 
-  PrototypeASTNode(std::string name, std::vector<std::string> args, Type type, std::unique_ptr<VariableDeclarationASTNode> returnValue)
-      : m_type(type), m_name(name), m_args(std::move(args)), m_returnValue(std::move(returnValue)) {}
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Prototype; }
+  PrototypeASTNode(SymbolId name, llvm::ArrayRef<SymbolId> args, Type type, VariableDeclarationASTNode *returnValue)
+      : ASTNode(Kind::Prototype), m_type(type), m_name(name), m_args(args), m_returnValue(returnValue) {}
   void print(int level = 0) const;
-  const std::string &getName() { return m_name; }
+  SymbolId getName() const { return m_name; }
+  llvm::ArrayRef<SymbolId> getArgs() const { return m_args; }
   llvm::Function *codegen(GenContext &gen) const;
-  std::unique_ptr<VariableDeclarationASTNode> getReturnValue() { return std::move(m_returnValue); }
+  VariableDeclarationASTNode *getReturnValue() const { return m_returnValue; }
   Type m_type;
 
 private:
-  std::string m_name;
-  std::vector<std::string> m_args;
-  std::unique_ptr<VariableDeclarationASTNode> m_returnValue;
+  SymbolId m_name;
+  llvm::ArrayRef<SymbolId> m_args;
+  VariableDeclarationASTNode *m_returnValue;
 };
 
 class FunctionASTNode : public ASTNode
 {
-  std::unique_ptr<PrototypeASTNode> m_prototype;
-  std::vector<std::unique_ptr<VariableDeclarationASTNode>> m_variables;
-  std::vector<std::unique_ptr<ConstantDeclarationASTNode>> m_constants;
-  std::unique_ptr<BlockStatmentASTNode> m_body;
+  PrototypeASTNode *m_prototype;
+  llvm::ArrayRef<VariableDeclarationASTNode *> m_variables;
+  llvm::ArrayRef<ConstantDeclarationASTNode *> m_constants;
+  BlockStatmentASTNode *m_body;
 
 public:
-  FunctionASTNode(std::unique_ptr<PrototypeASTNode> prototype, std::vector<std::unique_ptr<VariableDeclarationASTNode>> variables,
-                  std::vector<std::unique_ptr<ConstantDeclarationASTNode>> constants, std::unique_ptr<BlockStatmentASTNode> body) : m_prototype(std::move(prototype)), m_variables(std::move(variables)), m_constants(std::move(constants)),
-                                                                                                                                    m_body(std::move(body)) {}
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Function; }
+  FunctionASTNode(PrototypeASTNode *prototype, llvm::ArrayRef<VariableDeclarationASTNode *> variables,
+                  llvm::ArrayRef<ConstantDeclarationASTNode *> constants, BlockStatmentASTNode *body) : ASTNode(Kind::Function), m_prototype(prototype), m_variables(variables), m_constants(constants),
+                                                        m_body(body) {}
   llvm::Function *codegen(GenContext &gen) const;
-  void print(int level = 0) const override;
+  void print(int level = 0) const;
+  // calls whose result the function returns right away: `name := call` in a function, a call
+  // statement in a procedure, as the last statement on a path through the body or before exit
+  void collectTailCalls(llvm::SmallPtrSetImpl<const FunctionCallExprASTNode *> &calls) const;
+  PrototypeASTNode *getPrototype() const { return m_prototype; }
+  llvm::ArrayRef<VariableDeclarationASTNode *> getVariables() const { return m_variables; }
+  llvm::ArrayRef<ConstantDeclarationASTNode *> getConstants() const { return m_constants; }
+  BlockStatmentASTNode *getBody() const { return m_body; }
 };
 
 class ProgramASTNode : public ASTNode
 {
-  std::vector<std::unique_ptr<FunctionASTNode>> m_functions;
+  llvm::ArrayRef<FunctionASTNode *> m_functions;
 
 public:
-  ProgramASTNode(std::vector<std::unique_ptr<FunctionASTNode>> functions) : m_functions(std::move(functions)) {}
+  static bool classof(const ASTNode *node) { return node->getKind() == Kind::Program; }
+  ProgramASTNode(llvm::ArrayRef<FunctionASTNode *> functions) : ASTNode(Kind::Program), m_functions(functions) {}
   llvm::Value *codegen(GenContext &gen) const;
-  virtual void print(int level = 0) const override;
+  void print(int level = 0) const;
+  llvm::ArrayRef<FunctionASTNode *> getFunctions() const { return m_functions; }
 };
 
 #endif // PJPPROJECT_AST_HPP
\ No newline at end of file
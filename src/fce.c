@@ -1,14 +1,24 @@
 #include <stdio.h>
 
-int writeln(int x) {
-    printf("%d\n", x);
+#include "rtio.h"
+
+// names the runtime functions; runtime_jit.c compiles this file again under other names
+#ifndef MILA_RT
+#define MILA_RT(name) name
+#endif
+
+int MILA_RT(writeln)(int x) {
+    mila_out_int(x, 1);
     return 0;
 }
-int write(int x) {
-    printf("%d", x);
+int MILA_RT(write)(int x) {
+    mila_out_int(x, 0);
     return 0;
 }
-int readln(int *x) {
-    scanf("%d", x);
-    return 0;
+// the value read in the low 32 bits, what scanf("%d") returned (1, 0 or EOF) in the high ones;
+// returned rather than stored through a pointer so the variable read need not be in memory
+long long MILA_RT(readln)(void) {
+    int x = 0;
+    int status = mila_in_int(&x);
+    return (long long)((unsigned long long)(unsigned)status << 32 | (unsigned)x);
 }
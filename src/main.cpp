@@ -1,16 +1,92 @@
+#include "Emitter.hpp"
+#include "Interpreter.hpp"
+#include "Jit.hpp"
+#include "Optimizer.hpp"
+#include "Tiered.hpp"
 #include "Parser.hpp"
 
+#include <llvm/Support/CommandLine.h>
+
 // Use tutorials in: https://llvm.org/docs/tutorial/
 
+static llvm::cl::opt<std::string> InputFile(llvm::cl::Positional, llvm::cl::desc("<input file>"), llvm::cl::init("-"));
+static llvm::cl::opt<unsigned> Jobs("j", llvm::cl::Prefix, llvm::cl::desc("Number of threads parsing function bodies and compiling large executables (0 = all hardware threads)"), llvm::cl::value_desc("N"), llvm::cl::init(0));
+static llvm::cl::alias JobsLong("jobs", llvm::cl::desc("Alias for -j"), llvm::cl::aliasopt(Jobs));
+static llvm::cl::opt<bool> Eager("eager", llvm::cl::desc("Parse and compile every function, not only those reachable from the main block"));
+static llvm::cl::opt<unsigned> OptLevel("O", llvm::cl::Prefix, llvm::cl::desc("Optimization level: -O0, -O1, -O2 or -O3 (default -O0)"), llvm::cl::init(0));
+static llvm::cl::alias OptLevelLong("optimize", llvm::cl::desc("Alias for -O"), llvm::cl::aliasopt(OptLevel));
+static llvm::cl::opt<EmitKind> Emit("emit", llvm::cl::desc("Kind of output (default exe for an input file, llvm for standard input)"), llvm::cl::init(EmitKind::LLVM),
+                                    llvm::cl::values(clEnumValN(EmitKind::LLVM, "llvm", "Textual LLVM IR"),
+                                                     clEnumValN(EmitKind::Bitcode, "bc", "LLVM bitcode"),
+                                                     clEnumValN(EmitKind::Assembly, "asm", "Native assembly"),
+                                                     clEnumValN(EmitKind::Object, "obj", "Native object file"),
+                                                     clEnumValN(EmitKind::Executable, "exe", "Executable linked with the runtime")));
+static llvm::cl::opt<std::string> OutputFile("o", llvm::cl::desc("Output file (default a.out for executables, standard output otherwise)"), llvm::cl::value_desc("file"), llvm::cl::init("-"));
+static llvm::cl::alias OutputFileLong("output", llvm::cl::desc("Alias for -o"), llvm::cl::aliasopt(OutputFile));
+static llvm::cl::opt<bool> Verbose("v", llvm::cl::desc("Print the linker command line and the functions --tiered compiles"));
+static llvm::cl::alias VerboseLong("verbose", llvm::cl::desc("Alias for -v"), llvm::cl::aliasopt(Verbose));
+static llvm::cl::opt<bool> Debug("d", llvm::cl::desc("Keep the intermediate object file next to the executable"));
+// not --debug: LLVM builds with assertions register that option globally
+static llvm::cl::alias DebugLong("keep-object", llvm::cl::desc("Alias for -d"), llvm::cl::aliasopt(Debug));
+// the mila script's -f/--force, outputs are always overwritten
+static llvm::cl::opt<bool> Force("f", llvm::cl::Hidden, llvm::cl::desc("Ignored, kept for old scripts"));
+static llvm::cl::alias ForceLong("force", llvm::cl::Hidden, llvm::cl::desc("Alias for -f"), llvm::cl::aliasopt(Force));
+static llvm::cl::opt<bool> Run("run", llvm::cl::desc("Compile in memory and run the program instead of writing any output"));
+static llvm::cl::opt<bool> Interpret("interpret", llvm::cl::desc("Run the program in the bytecode interpreter, without LLVM code generation"));
+static llvm::cl::opt<bool> Tiered("tiered", llvm::cl::desc("Interpret the program and compile hot functions with LLVM in the background"));
+static llvm::cl::opt<unsigned> TierThreshold("tier-threshold", llvm::cl::desc("Calls plus loop iterations that make a function hot (default 1000)"), llvm::cl::value_desc("N"), llvm::cl::init(1000));
+static llvm::cl::opt<bool> ParseStats("parse-stats", llvm::cl::desc("Print token buffer and AST arena statistics to stderr"));
+
 int main (int argc, char *argv[])
 {
-    Parser parser;
+    llvm::cl::ParseCommandLineOptions(argc, argv, "mila compiler\n");
+
+    try
+    {
+        // source file to compile, standard input when not given
+        Parser parser(InputFile);
+
+        if (!parser.Parse(Jobs, !Eager)) {
+            return 1;
+        }
+        if (ParseStats)
+            parser.printStatistics(std::cerr);
+
+        if (Interpret)
+            return Interpreter(*parser.getProgram()).run();
+        if (Tiered)
+            return runTiered(*parser.getProgram(), TierThreshold, Verbose);
 
-    if (!parser.Parse()) {
+        llvm::Module &module = parser.Generate();
+        std::unique_ptr<llvm::TargetMachine> target = createHostTargetMachine(OptLevel);
+        module.setTargetTriple(target->getTargetTriple().str());
+        module.setDataLayout(target->createDataLayout());
+        // like cc: a source file becomes a.out, standard input keeps printing IR
+        EmitKind emit = Emit.getNumOccurrences() ? Emit : InputFile == "-" ? EmitKind::LLVM : EmitKind::Executable;
+        // a whole program only exports main, the rest may use fastcc and its guaranteed tail calls
+        if (Run || emit == EmitKind::Executable)
+            internalizeFunctions(module, module.getFunction("main"));
+        // --run keeps the compiler's runtime: output buffered in a copy inside the JIT could not be flushed at exit
+        if (OptLevel > 0 && !Run)
+            linkRuntime(module);
+        optimizeModule(module, OptLevel, target.get());
+
+        if (Run)
+        {
+            auto [context, program] = parser.takeModule();
+            return runModule(std::move(context), std::move(program), OptLevel);
+        }
+
+        if (emit == EmitKind::Executable)
+            emitExecutable(module, *target, OutputFile.getNumOccurrences() ? std::string(OutputFile) : "a.out", Debug, Verbose, Jobs);
+        else
+            emitModule(module, *target, emit, OutputFile);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
         return 1;
     }
 
-    parser.Generate().print(llvm::outs(), nullptr);
-
     return 0;
 }
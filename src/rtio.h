@@ -0,0 +1,245 @@
+#ifndef PJPPROJECT_RTIO_H
+#define PJPPROJECT_RTIO_H
+
+/*
+ * Input and output layer of the runtime, included by fce.c only.
+ *
+ * Output: integers are formatted two digits at a time into a 64 KiB buffer
+ * that goes out in one piece when it fills up, before input blocks and at
+ * exit. On a terminal every line is flushed, like stdio does. fce.c defines
+ * the Mila function `write`, which in a linked program takes the symbol of
+ * write(2), so the buffer is handed over with fwrite: stdio passes a block
+ * that size straight to the system call.
+ *
+ * Input: stdin is read with read(2) in blocks of up to 64 KiB, a read returns
+ * what is available so terminals and pipes work line by line. Integers are
+ * parsed exactly like scanf("%d"), the end of a digit run found 16 bytes at a
+ * time with SSE2 where the compiler targets it.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// MILA_IN_SCALAR keeps the portable code on SSE2 targets too, to compare the two (bench/input.c)
+#if defined(__SSE2__) && !defined(MILA_IN_SCALAR)
+#define MILA_IN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// unistd.h would declare write(2), which clashes with the Mila function
+int isatty(int fd);
+ssize_t read(int fd, void *buffer, size_t count);
+
+#define MILA_OUT_BUFFER_SIZE (1 << 16)
+#define MILA_OUT_INT_SIZE 12 // "-2147483648\n"
+
+static char mila_out_buffer[MILA_OUT_BUFFER_SIZE];
+static size_t mila_out_used;
+static int mila_out_mode; // 0 before the first output, 1 buffered, 2 flushing every line
+
+static const char mila_out_digit_pairs[201] = "0001020304050607080910111213141516171819"
+                                              "2021222324252627282930313233343536373839"
+                                              "4041424344454647484950515253545556575859"
+                                              "6061626364656667686970717273747576777879"
+                                              "8081828384858687888990919293949596979899";
+
+static void mila_out_flush(void)
+{
+    if (mila_out_used == 0)
+        return;
+    fwrite(mila_out_buffer, 1, mila_out_used, stdout);
+    fflush(stdout);
+    mila_out_used = 0;
+}
+
+static void mila_out_start(void)
+{
+    atexit(mila_out_flush);
+    mila_out_mode = isatty(1) ? 2 : 1;
+}
+
+// appends x in decimal, followed by a newline if `newline` is set
+static void mila_out_int(int x, int newline)
+{
+    if (mila_out_mode == 0)
+        mila_out_start();
+    if (MILA_OUT_BUFFER_SIZE - mila_out_used < MILA_OUT_INT_SIZE)
+        mila_out_flush();
+
+    // digits from the back of a scratch buffer, then one copy of the whole number
+    char digits[MILA_OUT_INT_SIZE];
+    char *end = digits + sizeof digits, *first = end;
+    unsigned value = x < 0 ? 0u - (unsigned)x : (unsigned)x;
+    while (value >= 100)
+    {
+        unsigned pair = value % 100 * 2;
+        value /= 100;
+        first -= 2;
+        memcpy(first, mila_out_digit_pairs + pair, 2);
+    }
+    if (value >= 10)
+    {
+        first -= 2;
+        memcpy(first, mila_out_digit_pairs + value * 2, 2);
+    }
+    else
+        *--first = (char)('0' + value);
+    if (x < 0)
+        *--first = '-';
+
+    memcpy(mila_out_buffer + mila_out_used, first, (size_t)(end - first));
+    mila_out_used += (size_t)(end - first);
+    if (newline)
+    {
+        mila_out_buffer[mila_out_used++] = '\n';
+        if (mila_out_mode == 2)
+            mila_out_flush();
+    }
+}
+
+#define MILA_IN_BUFFER_SIZE (1 << 16)
+#define MILA_IN_PADDING 16 // vector loads may look past the data read
+
+static char mila_in_buffer[MILA_IN_BUFFER_SIZE + MILA_IN_PADDING];
+static size_t mila_in_pos, mila_in_end;
+static int mila_in_eof;
+
+/*
+ * Moves the unread rest to the front and reads more behind it. Returns 0 at
+ * the end of the input or on a read error, which scanf treats the same.
+ */
+static int mila_in_fill(void)
+{
+    if (mila_in_eof)
+        return 0;
+    // about to block: what was written so far, e.g. a prompt, has to be visible
+    mila_out_flush();
+    memmove(mila_in_buffer, mila_in_buffer + mila_in_pos, mila_in_end - mila_in_pos);
+    mila_in_end -= mila_in_pos;
+    mila_in_pos = 0;
+    ssize_t count;
+    do
+        count = read(0, mila_in_buffer + mila_in_end, MILA_IN_BUFFER_SIZE - mila_in_end);
+    while (count < 0 && errno == EINTR);
+    if (count <= 0)
+    {
+        mila_in_eof = 1;
+        return 0;
+    }
+    mila_in_end += (size_t)count;
+    return 1;
+}
+
+// the characters isspace accepts in the C locale, as scanf skips them
+static int mila_in_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static int mila_in_digit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+// length of the run of digits starting at `text`, looking at `available` bytes at most
+static size_t mila_in_digit_run(const char *text, size_t available)
+{
+    size_t length = 0;
+#ifdef MILA_IN_SSE2
+    // bytes '0'..'9' become -128..-119 after the shift, the only ones below -118
+    const __m128i shift = _mm_set1_epi8((char)(0x80 - '0'));
+    const __m128i limit = _mm_set1_epi8((char)(-128 + 10));
+    while (length < available)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(text + length));
+        unsigned digits = (unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(_mm_add_epi8(chunk, shift), limit));
+        if (digits != 0xFFFF)
+        {
+            length += (size_t)__builtin_ctz(~digits);
+            break;
+        }
+        length += 16;
+    }
+    return length < available ? length : available;
+#else
+    while (length < available && mila_in_digit(text[length]))
+        ++length;
+    return length;
+#endif
+}
+
+#ifdef MILA_IN_SSE2
+// value of eight ASCII digits, converted as one little-endian 64-bit word in three multiplications
+static unsigned long long mila_in_eight_digits(const char *digits)
+{
+    unsigned long long word;
+    memcpy(&word, digits, 8);
+    word -= 0x3030303030303030ull;
+    word = word * 10 + (word >> 8);
+    return ((word & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+            ((word >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+}
+#endif
+
+/*
+ * scanf("%d", x): skips whitespace, takes an optional sign and all digits
+ * that follow, leaving the first other character unread. The value is that
+ * of strtol converted to int. Returns 1 when x was stored, 0 if no digit
+ * followed (a sign stays consumed) and EOF if the input ended before the number.
+ */
+static int mila_in_int(int *x)
+{
+    for (;;)
+    {
+        while (mila_in_pos < mila_in_end && mila_in_space(mila_in_buffer[mila_in_pos]))
+            ++mila_in_pos;
+        if (mila_in_pos < mila_in_end)
+            break;
+        if (!mila_in_fill())
+            return EOF;
+    }
+
+    int negative = 0;
+    if (mila_in_buffer[mila_in_pos] == '-' || mila_in_buffer[mila_in_pos] == '+')
+    {
+        negative = mila_in_buffer[mila_in_pos++] == '-';
+        if (mila_in_pos == mila_in_end && !mila_in_fill())
+            return 0;
+    }
+    if (!mila_in_digit(mila_in_buffer[mila_in_pos]))
+        return 0;
+
+    // strtol saturates at LONG_MAX, or LONG_MIN for negative numbers
+    unsigned long long limit = negative ? 0ull - (unsigned long long)LONG_MIN : (unsigned long long)LONG_MAX;
+    unsigned long long value = 0;
+    int overflow = 0;
+    do
+    {
+        size_t run = mila_in_digit_run(mila_in_buffer + mila_in_pos, mila_in_end - mila_in_pos);
+        const char *digit = mila_in_buffer + mila_in_pos, *end = digit + run;
+#ifdef MILA_IN_SSE2
+        // eight digits per step while the value stays below 10^18
+        for (; end - digit >= 8 && value < 10000000000ull; digit += 8)
+            value = value * 100000000ull + mila_in_eight_digits(digit);
+        overflow |= value > limit;
+#endif
+        for (; digit != end; ++digit)
+        {
+            overflow |= value > (ULLONG_MAX - 9) / 10;
+            value = value * 10 + (unsigned long long)(*digit - '0');
+            overflow |= value > limit;
+        }
+        mila_in_pos += run;
+        // the number may go on in the next block
+    } while (mila_in_pos == mila_in_end && mila_in_fill());
+
+    long number = overflow ? (negative ? LONG_MIN : LONG_MAX) : negative ? (long)(0ull - value) : (long)value;
+    *x = (int)number;
+    return 1;
+}
+
+#endif // PJPPROJECT_RTIO_H
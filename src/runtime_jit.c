@@ -0,0 +1,5 @@
+// The runtime linked into the compiler itself for --run. Prefixed names keep
+// `write` from replacing the C library's write(2) in the compiler process;
+// the JIT maps the unprefixed names to these.
+#define MILA_RT(name) mila_rt_##name
+#include "fce.c"
@@ -6,11 +6,14 @@ if(NOT expected)
    message(FATAL_ERROR "Variable expected not defined")
 endif()
 
+# optional command line arguments of the executable, e.g. "--interpret <source>"
+separate_arguments(arguments UNIX_COMMAND "${arguments}")
+
 # message(WARNING "exec=${executable} ; expec=${expected} ; input=${input}")
 
 if(input)
 	execute_process(
-		COMMAND ${executable}
+		COMMAND ${executable} ${arguments}
 		INPUT_FILE ${input}
 		OUTPUT_VARIABLE output
 		OUTPUT_STRIP_TRAILING_WHITESPACE
@@ -18,7 +21,7 @@ if(input)
 	)
 else()
 	execute_process(
-		COMMAND ${executable}
+		COMMAND ${executable} ${arguments}
 		OUTPUT_VARIABLE output
 		OUTPUT_STRIP_TRAILING_WHITESPACE
 		RESULT_VARIABLE RETCODE